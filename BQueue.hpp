@@ -0,0 +1,302 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// B-Queue style SPSC fifo. As in FastForwardFifo each slot carries its own
+/// full flag and neither thread reads the other's cursor, but rather than
+/// checking the flag of every slot each thread probes a batch ahead.
+///
+/// Slots are filled and emptied in order, so if the slot Batch - 1 ahead of
+/// the push cursor is empty then so is every slot before it, and the push
+/// thread may fill the whole batch without looking at the shared lines
+/// again; likewise the pop thread for full slots. If the probe fails the
+/// thread backtracks, halving the distance until a probe succeeds or the
+/// next slot itself is found full or empty. Backtracking lets the pop
+/// thread keep up with a slow push thread that never fills a whole batch.
+///
+/// @tparam Batch the furthest distance probed; capped at the capacity
+template<typename T, typename Alloc = std::allocator<T>, std::size_t Batch = 64>
+    requires std::is_trivial_v<T> && (Batch > 0)
+class BQueue
+{
+    struct Slot;
+
+public:
+    using value_type = T;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit BQueue(size_type capacity, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , mask_{capacity - 1}
+        , batch_{std::min(size_type{Batch}, capacity)}
+        , ring_{allocator_traits::allocate(alloc_, capacity)} {
+        assert((capacity & mask_) == 0);
+        for (auto cursor = size_type{}; cursor < capacity; ++cursor) {
+            new (&ring_[cursor]) Slot{false, T{}};
+        }
+    }
+
+    BQueue(BQueue const&) = delete;
+    BQueue& operator=(BQueue const&) = delete;
+
+    ~BQueue() {
+        allocator_traits::deallocate(alloc_, ring_, capacity());
+    }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        // Load the pop cursor first; it may overtake an earlier load of the
+        // push cursor
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(BQueue* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                // Store the cursor first so that the pop thread, once it
+                // sees the flag, sees the cursor past this slot too
+                fifo_->pushCursor_.store(cursor_ + 1, std::memory_order_relaxed);
+                fifo_->slot(cursor_).full.store(true, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return &fifo_->slot(cursor_).value; }
+        value_type const* get() const noexcept { return &fifo_->slot(cursor_).value; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        BQueue* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher. Probes for
+    /// free slots only at the end of the last batch found.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (pushCursor == pushLimit_) {
+            pushLimit_ = pushCursor + probe(pushCursor, false);
+            if (pushCursor == pushLimit_) {
+                return pusher_t{};
+            }
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's ring. The
+    /// actual pop happens when the popper goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(BQueue* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                // Store the cursor first so that the push thread, once it
+                // sees the flag, sees the cursor past this slot too
+                fifo_->popCursor_.store(cursor_ + 1, std::memory_order_relaxed);
+                fifo_->slot(cursor_).full.store(false, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return &fifo_->slot(cursor_).value; }
+        value_type const* get() const noexcept { return &fifo_->slot(cursor_).value; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        BQueue* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    /// Optionally pop one object via a popper. Probes for full slots only
+    /// at the end of the last batch found.
+    auto pop() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (popCursor == popLimit_) {
+            popLimit_ = popCursor + probe(popCursor, true);
+            if (popCursor == popLimit_) {
+                return popper_t{};
+            }
+        }
+        return popper_t(this, popCursor);
+    };
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Slot
+    {
+        /// Stored by the push thread to fill the slot and by the pop
+        /// thread to empty it
+        std::atomic<bool> full;
+        T value;
+    };
+
+    /// Returns the length of the run of slots from `cursor` whose full
+    /// flag is `full`, trying batch_, then half that and so on down to 1;
+    /// 0 if even the slot at `cursor` is not.
+    size_type probe(size_type cursor, bool full) noexcept {
+        for (auto distance = batch_; distance != 0; distance /= 2) {
+            if (slot(cursor + distance - 1).full.load(std::memory_order_acquire) == full) {
+                return distance;
+            }
+        }
+        return 0;
+    }
+
+    auto& slot(size_type cursor) noexcept { return ring_[cursor & mask_]; }
+
+private:
+    [[no_unique_address]] allocator_type alloc_;
+    size_type mask_;
+    size_type batch_;
+    Slot* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded only by size()
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread; the end of the slots known to be empty
+    size_type pushLimit_{};
+
+    /// Loaded and stored by the pop thread; loaded only by size()
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Exclusive to the pop thread; the end of the slots known to be full
+    size_type popLimit_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 2*sizeof(size_type)];
+};
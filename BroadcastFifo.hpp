@@ -0,0 +1,313 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// Single-producer, multi-consumer broadcast FIFO: every consumer pops
+/// every element. Each consumer has its own pop cursor on its own cache
+/// line. The push thread caches the slowest consumer's pop cursor, as
+/// Fifo5 caches the pop cursor, and only rescans all the consumers' cursors
+/// when the fifo appears full.
+template<typename T, typename Alloc = std::allocator<T>>
+    requires std::is_trivial_v<T>
+class BroadcastFifo : private Alloc
+{
+    struct Consumer;
+
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    /// @param consumers the number of pop threads; each pops with its own
+    /// index in [0, consumers)
+    explicit BroadcastFifo(size_type capacity, size_type consumers, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , mask_{capacity - 1}
+        , ring_{allocator_traits::allocate(*this, capacity)}
+        , consumerCount_{consumers}
+        , consumers_{allocateConsumers(consumers)} {
+        assert((capacity & mask_) == 0);
+        assert(consumers != 0);
+    }
+
+    BroadcastFifo(BroadcastFifo const&) = delete;
+    BroadcastFifo& operator=(BroadcastFifo const&) = delete;
+
+    ~BroadcastFifo() {
+        auto alloc = consumer_allocator_type(static_cast<Alloc const&>(*this));
+        consumer_allocator_traits::deallocate(alloc, consumers_, consumerCount_);
+        allocator_traits::deallocate(*this, ring_, capacity());
+    }
+
+
+    /// Returns the number of elements the slowest consumer has yet to pop
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        return pushCursor - minPopCursor(std::memory_order_relaxed);
+    }
+
+    /// Returns the number of elements `consumer` has yet to pop
+    auto size(size_type consumer) const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = consumers_[consumer].popCursor.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether every consumer has popped every element
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether `consumer` has popped every element
+    auto empty(size_type consumer) const noexcept { return size(consumer) == 0; }
+
+    /// Returns whether the slowest consumer has capacity_() elements to pop
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+    /// Returns the number of consumers
+    auto consumers() const noexcept { return consumerCount_; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(BroadcastFifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                fifo_->pushCursor_.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        BroadcastFifo* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (full(pushCursor, minPopCursorCached_)) {
+            minPopCursorCached_ = minPopCursor(std::memory_order_acquire);
+            if (full(pushCursor, minPopCursorCached_)) {
+                return pusher_t{};
+            }
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to read
+    /// the element directly in the fifo's ring. The actual pop happens
+    /// when the popper goes out of scope. Other consumers may be reading
+    /// the same element so it is only available as const.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(Consumer* consumer, value_type const* element, size_type cursor) noexcept
+            : consumer_{consumer}, element_{element}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : consumer_{std::move(other.consumer_)}
+            , element_{std::move(other.element_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            consumer_ = std::move(other.consumer_);
+            element_ = std::move(other.element_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (consumer_) {
+                consumer_->popCursor.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { consumer_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return consumer_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type const* get() const noexcept { return element_; }
+        value_type const& operator*() const noexcept { return *get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        Consumer* consumer_{};
+        value_type const* element_;
+        size_type cursor_;
+    };
+
+    /// Optionally pop one object for `consumer` via a popper. Each
+    /// consumer index must only be used by one thread.
+    auto pop(size_type consumer) noexcept {
+        assert(consumer < consumerCount_);
+        auto& self = consumers_[consumer];
+        auto popCursor = self.popCursor.load(std::memory_order_relaxed);
+        if (empty(self.pushCursorCached, popCursor)) {
+            self.pushCursorCached = pushCursor_.load(std::memory_order_acquire);
+            if (empty(self.pushCursorCached, popCursor)) {
+                return popper_t{};
+            }
+        }
+        return popper_t(&self, element(popCursor), popCursor);
+    }
+
+    /// Pop one object for `consumer` from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if
+    /// `consumer` has popped every element.
+    auto pop(size_type consumer, T& value) noexcept {
+        if (auto popper = pop(consumer); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// One consumer's cache line
+    struct alignas(hardware_destructive_interference_size) Consumer
+    {
+        /// Loaded and stored by this consumer; loaded by the push thread
+        /// when it rescans
+        std::atomic<size_type> popCursor{};
+
+        /// Exclusive to this consumer
+        size_type pushCursorCached{};
+    };
+
+    using consumer_allocator_type = typename allocator_traits::template rebind_alloc<Consumer>;
+    using consumer_allocator_traits = std::allocator_traits<consumer_allocator_type>;
+
+    Consumer* allocateConsumers(size_type consumers) {
+        auto alloc = consumer_allocator_type(static_cast<Alloc const&>(*this));
+        auto result = consumer_allocator_traits::allocate(alloc, consumers);
+        std::uninitialized_default_construct_n(result, consumers);
+        return result;
+    }
+
+    /// Returns the slowest consumer's pop cursor
+    auto minPopCursor(std::memory_order order) const noexcept {
+        auto minCursor = consumers_[0].popCursor.load(order);
+        for (auto consumer = size_type{1}; consumer < consumerCount_; ++consumer) {
+            minCursor = std::min(minCursor, consumers_[consumer].popCursor.load(order));
+        }
+        return minCursor;
+    }
+
+    auto full(size_type pushCursor, size_type popCursor) const noexcept {
+        assert(popCursor <= pushCursor);
+        return (pushCursor - popCursor) == capacity();
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    auto* element(size_type cursor) noexcept { return &ring_[cursor & mask_]; }
+
+private:
+    size_type mask_;
+    T* ring_;
+    size_type consumerCount_;
+    Consumer* consumers_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    /// Loaded and stored by the push thread; loaded by the pop threads
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    alignas(hardware_destructive_interference_size) size_type minPopCursorCached_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+
+
+/// Variable-length message FIFO using Fifo5's cached cursors. Messages are
+/// stored in a byte ring as records: a size_type length header followed by
+/// the message bytes, padded to a multiple of the header size. A record
+/// that would straddle the end of the ring is placed at the start instead
+/// and the unused tail is marked with a skip header.
+///
+/// The skipped tail counts against the capacity until the record after it
+/// is popped, so a record can only be guaranteed to fit an empty fifo,
+/// whatever the cursor position, if it takes at most half the ring. See
+/// maxMessageSize().
+template<typename Alloc = std::allocator<std::byte>>
+class ByteFifo : private Alloc
+{
+public:
+    using value_type = std::byte;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    /// @param capacity size of the ring in bytes; must be a power of two
+    /// and at least the size of four headers
+    explicit ByteFifo(size_type capacity, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , mask_{capacity - 1}
+        , ring_{allocator_traits::allocate(*this, capacity)} {
+        assert((capacity & mask_) == 0);
+        assert(capacity >= 4*headerSize);
+        assert(reinterpret_cast<std::uintptr_t>(ring_) % alignof(size_type) == 0);
+    }
+
+    ~ByteFifo() {
+        allocator_traits::deallocate(*this, ring_, capacity());
+    }
+
+
+    /// Returns the number of bytes, including headers and padding, in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no messages
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns the size of the ring in bytes
+    auto capacity() const noexcept { return mask_ + 1; }
+
+    /// Returns the size in bytes of the largest message that may be
+    /// reserved or pushed
+    auto maxMessageSize() const noexcept { return capacity()/2 - headerSize; }
+
+
+    /// Reserve room for one message of `size` bytes, which must not be
+    /// zero nor more than maxMessageSize(). The message is not visible to the pop thread until commit()
+    /// is called.
+    /// @return a span over the message's bytes in the ring; empty if the
+    /// fifo does not have room.
+    std::span<std::byte> reserve(size_type size) noexcept {
+        assert(size != 0 && size <= maxMessageSize());
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto record = recordSize(size);
+        auto skip = contiguous(pushCursor) < record ? contiguous(pushCursor) : size_type{};
+        if (not fits(pushCursor, skip + record, popCursorCached_)) {
+            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+            if (not fits(pushCursor, skip + record, popCursorCached_)) {
+                return {};
+            }
+        }
+
+        if (skip != 0) {
+            writeHeader(pushCursor, skipMarker);
+            pushCursor += skip;
+        }
+        reserveCursor_ = pushCursor;
+        reserveSize_ = size;
+        return {element(pushCursor) + headerSize, size};
+    }
+
+    /// Push the first `size` bytes of the message reserved by the last
+    /// successful reserve(). `size` must not be zero and must not exceed
+    /// the reserved size.
+    void commit(size_type size) noexcept {
+        assert(size != 0 && size <= reserveSize_);
+        writeHeader(reserveCursor_, size);
+        pushCursor_.store(reserveCursor_ + recordSize(size), std::memory_order_release);
+    }
+
+    /// Push all of the message reserved by the last successful reserve()
+    void commit() noexcept { commit(reserveSize_); }
+
+    /// Push one message onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo does
+    /// not have room.
+    auto push(std::span<std::byte const> message) noexcept {
+        if (auto buffer = reserve(message.size()); not buffer.empty()) {
+            std::memcpy(buffer.data(), message.data(), message.size());
+            commit();
+            return true;
+        }
+        return false;
+    }
+
+
+    /// Return the next message without popping it.
+    /// @return a span over the message's bytes in the ring; empty if the
+    /// fifo is empty.
+    std::span<std::byte const> peek() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursorCached_, popCursor)) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (empty(pushCursorCached_, popCursor)) {
+                return {};
+            }
+        }
+
+        auto size = readHeader(popCursor);
+        if (size == skipMarker) {
+            popCursor += contiguous(popCursor);
+            size = readHeader(popCursor);
+        }
+        peekCursor_ = popCursor + recordSize(size);
+        return {element(popCursor) + headerSize, size};
+    }
+
+    /// Pop the message returned by the last successful peek()
+    void release() noexcept {
+        popCursor_.store(peekCursor_, std::memory_order_release);
+    }
+
+private:
+    static constexpr auto headerSize = sizeof(size_type);
+    static constexpr auto skipMarker = ~size_type{};
+
+    /// Returns the number of ring bytes used by a message of `size` bytes
+    static auto recordSize(size_type size) noexcept {
+        return headerSize + (size + headerSize - 1) / headerSize * headerSize;
+    }
+
+    auto fits(size_type pushCursor, size_type bytes, size_type popCursor) const noexcept {
+        assert(popCursor <= pushCursor);
+        return capacity() - (pushCursor - popCursor) >= bytes;
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    /// Returns the number of bytes from `cursor` to the end of the ring
+    auto contiguous(size_type cursor) const noexcept { return capacity() - (cursor & mask_); }
+
+    auto* element(size_type cursor) noexcept { return &ring_[cursor & mask_]; }
+
+    void writeHeader(size_type cursor, size_type size) noexcept {
+        std::memcpy(element(cursor), &size, headerSize);
+    }
+    auto readHeader(size_type cursor) noexcept {
+        auto size = size_type{};
+        std::memcpy(&size, element(cursor), headerSize);
+        return size;
+    }
+
+private:
+    size_type mask_;
+    std::byte* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_;
+
+    /// Exclusive to the push thread
+    alignas(hardware_destructive_interference_size) size_type popCursorCached_{};
+    size_type reserveCursor_{};
+    size_type reserveSize_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_;
+
+    /// Exclusive to the pop thread
+    alignas(hardware_destructive_interference_size) size_type pushCursorCached_{};
+    size_type peekCursor_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 2*sizeof(size_type)];
+};
@@ -0,0 +1,428 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "FifoLayout.hpp"
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// @name Index policies for Fifo
+/// Map a cursor to a slot in the ring and count the elements between two
+/// cursors.
+///@{
+
+/// Cursors grow without bound and are reduced by remainder, as in Fifo4.
+/// Any capacity.
+class ModuloIndex
+{
+public:
+    explicit ModuloIndex(std::size_t capacity) noexcept : capacity_{capacity} {}
+
+    auto capacity() const noexcept { return capacity_; }
+    /// Returns the number of slots to allocate for the ring
+    auto slots() const noexcept { return capacity_; }
+
+    auto slot(std::size_t cursor) const noexcept { return cursor % capacity_; }
+    static auto next(std::size_t cursor) noexcept { return cursor + 1; }
+    static auto size(std::size_t pushCursor, std::size_t popCursor) noexcept {
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+private:
+    std::size_t capacity_;
+};
+
+/// Cursors grow without bound and are reduced by bitwise AND, as in Fifo4a.
+/// The capacity must be a power of 2.
+class MaskIndex
+{
+public:
+    explicit MaskIndex(std::size_t capacity) noexcept : mask_{capacity - 1} {
+        assert((capacity & mask_) == 0);
+    }
+
+    auto capacity() const noexcept { return mask_ + 1; }
+    /// Returns the number of slots to allocate for the ring
+    auto slots() const noexcept { return mask_ + 1; }
+
+    auto slot(std::size_t cursor) const noexcept { return cursor & mask_; }
+    static auto next(std::size_t cursor) noexcept { return cursor + 1; }
+    static auto size(std::size_t pushCursor, std::size_t popCursor) noexcept {
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+private:
+    std::size_t mask_;
+};
+
+/// Cursors are slot numbers that wrap to 0 at the end of the ring, as in
+/// Fifo4b. One slot is always left empty to tell a full fifo from an empty
+/// one. Any capacity.
+class ConstrainedIndex
+{
+public:
+    explicit ConstrainedIndex(std::size_t capacity) noexcept : slots_{capacity + 1} {}
+
+    auto capacity() const noexcept { return slots_ - 1; }
+    /// Returns the number of slots to allocate for the ring
+    auto slots() const noexcept { return slots_; }
+
+    static auto slot(std::size_t cursor) noexcept { return cursor; }
+    auto next(std::size_t cursor) const noexcept { return cursor + 1 == slots_ ? 0 : cursor + 1; }
+    auto size(std::size_t pushCursor, std::size_t popCursor) const noexcept {
+        return pushCursor >= popCursor ? pushCursor - popCursor : pushCursor + slots_ - popCursor;
+    }
+
+private:
+    std::size_t slots_;
+};
+///@}
+
+
+/// @name Cursor storage policies for Fifo
+///@{
+
+/// Cursors are std::atomic, as in Fifo5a
+struct AtomicCursor
+{
+    template<typename U>
+    class type
+    {
+    public:
+        U load(std::memory_order order) const noexcept { return value_.load(order); }
+        void store(U value, std::memory_order order) noexcept { value_.store(value, order); }
+
+    private:
+        static_assert(std::atomic<U>::is_always_lock_free);
+        std::atomic<U> value_{};
+    };
+};
+
+/// Cursors are plain values accessed through a std::atomic_ref kept beside
+/// them, as in Fifo5b
+struct AtomicRefCursor
+{
+    template<typename U>
+    class type
+    {
+    public:
+        type() = default;
+        type(type const&) = delete;
+        type& operator=(type const&) = delete;
+
+        U load(std::memory_order order) const noexcept { return ref_.load(order); }
+        void store(U value, std::memory_order order) noexcept { ref_.store(value, order); }
+
+    private:
+        static_assert(std::atomic_ref<U>::is_always_lock_free);
+        alignas(std::atomic_ref<U>::required_alignment) U value_{};
+        std::atomic_ref<U> ref_{value_};
+    };
+};
+///@}
+
+
+/// @name Memory order policies for Fifo
+///@{
+
+/// Each thread loads its own cursor relaxed, loads the other thread's cursor
+/// with acquire and publishes its own with release, as in Fifo4 onwards
+struct AcquireReleaseOrder
+{
+    static constexpr auto ownLoad = std::memory_order_relaxed;
+    static constexpr auto load = std::memory_order_acquire;
+    static constexpr auto store = std::memory_order_release;
+};
+
+/// Every cursor access is sequentially consistent, std::atomic's default
+struct SeqCstOrder
+{
+    static constexpr auto ownLoad = std::memory_order_seq_cst;
+    static constexpr auto load = std::memory_order_seq_cst;
+    static constexpr auto store = std::memory_order_seq_cst;
+};
+///@}
+
+
+/// Fifo5a's pusher and popper over policies for each of the dimensions in
+/// which Fifo3 to Fifo5b differ, so that any combination can be tried
+/// without another copy of the fifo. With the defaults it is Fifo5a
+/// without the blocking operations.
+///
+/// @tparam Index maps cursors to slots; ModuloIndex, MaskIndex or
+/// ConstrainedIndex
+/// @tparam Cursor how cursors are stored; AtomicCursor or AtomicRefCursor
+/// @tparam Cached whether each thread keeps a cached copy of the other
+/// thread's cursor, as in Fifo4, or loads it on every operation, as in Fifo3
+/// @tparam Order memory orders; AcquireReleaseOrder or SeqCstOrder
+/// @tparam Layout cursor layout policy; see FifoLayout.hpp
+template<
+    typename T,
+    typename Alloc = std::allocator<T>,
+    typename Index = MaskIndex,
+    typename Cursor = AtomicCursor,
+    bool Cached = true,
+    typename Order = AcquireReleaseOrder,
+    typename Layout = Padded64Layout>
+    requires std::is_trivial_v<T>
+class Fifo : private Alloc
+{
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit Fifo(size_type capacity, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , index_{capacity}
+        , ring_{allocator_traits::allocate(*this, index_.slots())}
+    {}
+
+    // AtomicRefCursor's cursors are not implicitly non-movable
+    Fifo(Fifo const&) = delete;
+    Fifo& operator=(Fifo const&) = delete;
+    Fifo(Fifo&&) = delete;
+    Fifo& operator=(Fifo&&) = delete;
+
+    ~Fifo() {
+        allocator_traits::deallocate(*this, ring_, index_.slots());
+    }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        // Load the pop cursor first; it may overtake an earlier load of the
+        // push cursor
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        return index_.size(pushCursor, popCursor);
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return index_.capacity(); }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(Fifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                fifo_->pushCursor_.store(fifo_->index_.next(cursor_), Order::store);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        Fifo* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursor_.load(Order::ownLoad);
+        if constexpr (Cached) {
+            if (full(pushCursor, popCursorCached_)) {
+                popCursorCached_ = popCursor_.load(Order::load);
+                if (full(pushCursor, popCursorCached_)) {
+                    return pusher_t{};
+                }
+            }
+        } else if (full(pushCursor, popCursor_.load(Order::load))) {
+            return pusher_t{};
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's ring. The
+    /// actual pop happens when the popper goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(Fifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                fifo_->popCursor_.store(fifo_->index_.next(cursor_), Order::store);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        Fifo* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    /// Optionally pop one object via a popper
+    auto pop() noexcept {
+        auto popCursor = popCursor_.load(Order::ownLoad);
+        if constexpr (Cached) {
+            if (empty(pushCursorCached_, popCursor)) {
+                pushCursorCached_ = pushCursor_.load(Order::load);
+                if (empty(pushCursorCached_, popCursor)) {
+                    return popper_t{};
+                }
+            }
+        } else if (empty(pushCursor_.load(Order::load), popCursor)) {
+            return popper_t{};
+        }
+        return popper_t(this, popCursor);
+    };
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    auto full(size_type pushCursor, size_type popCursor) const noexcept {
+        return index_.size(pushCursor, popCursor) == index_.capacity();
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    auto* element(size_type cursor) noexcept { return &ring_[index_.slot(cursor)]; }
+    auto const* element(size_type cursor) const noexcept { return &ring_[index_.slot(cursor)]; }
+
+private:
+    Index index_;
+    T* ring_;
+
+    using CursorType = typename Cursor::template type<size_type>;
+
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{Layout::lineSize};
+    static constexpr auto cachedCursorAlignment = Layout::separateCachedCursors
+        ? hardware_destructive_interference_size : size_type{alignof(size_type)};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_;
+
+    /// Exclusive to the push thread; unused unless Cached
+    alignas(cachedCursorAlignment) size_type popCursorCached_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_;
+
+    /// Exclusive to the pop thread; unused unless Cached
+    alignas(cachedCursorAlignment) size_type pushCursorCached_{};
+
+    // The alignment of the members above pads the fifo to whole lines,
+    // avoiding false sharing with adjacent objects
+};
@@ -5,9 +5,14 @@
 #include <memory>
 #include <new>
 
+#include "FifoLayout.hpp"
+
 
 /// Threadsafe, efficient circular FIFO
-template<typename T, typename Alloc = std::allocator<T>>
+///
+/// @tparam Layout cursor line size; see FifoLayout.hpp. Having no cached
+/// cursors, Fifo3 lays out CompactLayout as Padded64Layout.
+template<typename T, typename Alloc = std::allocator<T>, typename Layout = Padded64Layout>
 class Fifo3 : private Alloc
 {
 public:
@@ -100,7 +105,7 @@ private:
     // note: if this use is part of a public ABI, change it to instead use a constant variable you define
     // note: the default value for the current CPU tuning is 64 bytes
     // note: you can stabilize this value with ‘--param hardware_destructive_interference_size=64’, or disable this warning with ‘-Wno-interference-size’
-    static constexpr auto hardware_destructive_interference_size = size_type{64};
+    static constexpr auto hardware_destructive_interference_size = size_type{Layout::lineSize};
 
     /// Loaded and stored by the push thread; loaded by the pop thread
     alignas(hardware_destructive_interference_size) CursorType pushCursor_;
@@ -108,6 +113,6 @@ private:
     /// Loaded and stored by the pop thread; loaded by the push thread
     alignas(hardware_destructive_interference_size) CursorType popCursor_;
 
-    // Padding to avoid false sharing with adjacent objects
-    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+    // The alignment of the members above pads the fifo to whole lines,
+    // avoiding false sharing with adjacent objects
 };
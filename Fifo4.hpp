@@ -7,9 +7,16 @@
 
 #include <sanitizer/tsan_interface.h>
 
+#include "FifoLayout.hpp"
+#include "FifoStats.hpp"
+
 
 /// Threadsafe, efficient circular FIFO with cached cursors
-template<typename T, typename Alloc = std::allocator<T>>
+///
+/// @tparam Stats statistics policy; NoStats, the default, keeps none and
+/// CounterStats counts cached cursor refreshes, failures and occupancy.
+/// @tparam Layout cursor layout policy; see FifoLayout.hpp
+template<typename T, typename Alloc = std::allocator<T>, typename Stats = NoStats, typename Layout = Padded64Layout>
 class Fifo4 : private Alloc
 {
 public:
@@ -49,6 +56,12 @@ public:
     /// Returns the number of elements that can be held in the fifo
     auto capacity() const noexcept { return capacity_; }
 
+    /// Returns the push and pop threads' statistics. Reads only the
+    /// statistics, not the cursors.
+    FifoStatsSnapshot stats() const noexcept requires Stats::enabled {
+        return {pushStats_.snapshot(), popStats_.snapshot()};
+    }
+
 
     /// Push one object onto the fifo.
     /// @return `true` if the operation is successful; `false` if fifo is full.
@@ -57,7 +70,9 @@ public:
         if (full(pushCursor, popCursorCached_)) {
             popCursorCached_ = popCursor_.load(std::memory_order_acquire);
             // popCursorCached_ = popCursor_.load(std::memory_order_relaxed);
+            pushStats_.refresh(pushCursor - popCursorCached_);
             if (full(pushCursor, popCursorCached_)) {
+                pushStats_.fail();
                 return false;
             }
         }
@@ -76,7 +91,9 @@ public:
         if (empty(pushCursorCached_, popCursor)) {
             pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
             // pushCursorCached_ = pushCursor_.load(std::memory_order_relaxed);
+            popStats_.refresh(pushCursorCached_ - popCursor);
             if (empty(pushCursorCached_, popCursor)) {
+                popStats_.fail();
                 return false;
             }
         }
@@ -108,20 +125,24 @@ private:
     static_assert(CursorType::is_always_lock_free);
 
     // See Fifo3 for reason std::hardware_destructive_interference_size is not used directly
-    static constexpr auto hardware_destructive_interference_size = size_type{64};
+    static constexpr auto hardware_destructive_interference_size = size_type{Layout::lineSize};
+    static constexpr auto cachedCursorAlignment = Layout::separateCachedCursors
+        ? hardware_destructive_interference_size : size_type{alignof(size_type)};
 
     /// Loaded and stored by the push thread; loaded by the pop thread
     alignas(hardware_destructive_interference_size) CursorType pushCursor_;
 
     /// Exclusive to the push thread
-    alignas(hardware_destructive_interference_size) size_type popCursorCached_{};
+    alignas(cachedCursorAlignment) size_type popCursorCached_{};
+    [[no_unique_address]] typename Stats::Side pushStats_;
 
     /// Loaded and stored by the pop thread; loaded by the push thread
     alignas(hardware_destructive_interference_size) CursorType popCursor_;
 
     /// Exclusive to the pop thread
-    alignas(hardware_destructive_interference_size) size_type pushCursorCached_{};
+    alignas(cachedCursorAlignment) size_type pushCursorCached_{};
+    [[no_unique_address]] typename Stats::Side popStats_;
 
-    // Padding to avoid false sharing with adjacent objects
-    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+    // The alignment of the members above pads the fifo to whole lines,
+    // avoiding false sharing with adjacent objects
 };
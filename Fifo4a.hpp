@@ -5,9 +5,13 @@
 #include <memory>
 #include <new>
 
+#include "FifoLayout.hpp"
+
 
 /// Threadsafe, efficient circular FIFO with cached cursors; bitwise AND vs remainder
-template<typename T, typename Alloc = std::allocator<T>>
+///
+/// @tparam Layout cursor layout policy; see FifoLayout.hpp
+template<typename T, typename Alloc = std::allocator<T>, typename Layout = Padded64Layout>
 class Fifo4a : private Alloc
 {
 public:
@@ -100,20 +104,22 @@ private:
     static_assert(CursorType::is_always_lock_free);
 
     // See Fifo3 for reason std::hardware_destructive_interference_size is not used directly
-    static constexpr auto hardware_destructive_interference_size = size_type{64};
+    static constexpr auto hardware_destructive_interference_size = size_type{Layout::lineSize};
+    static constexpr auto cachedCursorAlignment = Layout::separateCachedCursors
+        ? hardware_destructive_interference_size : size_type{alignof(size_type)};
 
     /// Loaded and stored by the push thread; loaded by the pop thread
     alignas(hardware_destructive_interference_size) CursorType pushCursor_;
 
     /// Exclusive to the push thread
-    alignas(hardware_destructive_interference_size) size_type popCursorCached_{};
+    alignas(cachedCursorAlignment) size_type popCursorCached_{};
 
     /// Loaded and stored by the pop thread; loaded by the push thread
     alignas(hardware_destructive_interference_size) CursorType popCursor_;
 
     /// Exclusive to the pop thread
-    alignas(hardware_destructive_interference_size) size_type pushCursorCached_{};
+    alignas(cachedCursorAlignment) size_type pushCursorCached_{};
 
-    // Padding to avoid false sharing with adjacent objects
-    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+    // The alignment of the members above pads the fifo to whole lines,
+    // avoiding false sharing with adjacent objects
 };
@@ -1,12 +1,20 @@
 #pragma once
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <memory>
 #include <new>
+#include <span>
 #include <type_traits>
 
+#include "FifoLayout.hpp"
+#include "FifoStats.hpp"
+#include "FifoWait.hpp"
+
 /// A trait used to optimize the number of bytes copied. Specialize this
 /// on the type used to parameterize the Fifo5 to implement the
 /// optimization. The general template returns `sizeof(T)`.
@@ -19,7 +27,10 @@ struct ValueSizeTraits
 
 
 /// Require trivial, add ValueSizeTraits, pusher and popper to Fifo4
-template<typename T, typename Alloc = std::allocator<T>>
+///
+/// @tparam Layout cursor layout policy; see FifoLayout.hpp
+/// @tparam Wait blocking policy; FutexWait adds pushWait() and popWait()
+template<typename T, typename Alloc = std::allocator<T>, typename Stats = NoStats, typename Layout = Padded64Layout, typename Wait = NoWait>
     requires std::is_trivial_v<T>
 class Fifo5 : private Alloc
 {
@@ -57,6 +68,12 @@ public:
     /// Returns the number of elements that can be held in the fifo
     auto capacity() const noexcept { return capacity_; }
 
+    /// Returns the push and pop threads' statistics. Reads only the
+    /// statistics, not the cursors.
+    FifoStatsSnapshot stats() const noexcept requires Stats::enabled {
+        return {pushStats_.snapshot(), popStats_.snapshot()};
+    }
+
 
     /// An RAII proxy object returned by push(). Allows the caller to
     /// manipulate value_type's members directly in the fifo's ring. The
@@ -84,7 +101,7 @@ public:
 
         ~pusher_t() {
             if (fifo_) {
-                fifo_->pushCursor_.store(cursor_ + 1, std::memory_order_release);
+                fifo_->publishPush(cursor_ + 1);
             }
         }
 
@@ -127,8 +144,9 @@ public:
     pusher_t push() noexcept {
         auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
         if (full(pushCursor, popCursorCached_)) {
-            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+            refreshPopCursor(pushCursor);
             if (full(pushCursor, popCursorCached_)) {
+                pushStats_.fail();
                 return pusher_t{};
             }
         }
@@ -171,7 +189,7 @@ public:
 
         ~popper_t() {
             if (fifo_) {
-                fifo_->popCursor_.store(cursor_ + 1, std::memory_order_release);
+                fifo_->publishPop(cursor_ + 1);
             }
         }
 
@@ -204,8 +222,9 @@ public:
     auto pop() noexcept {
         auto popCursor = popCursor_.load(std::memory_order_relaxed);
         if (empty(pushCursorCached_, popCursor)) {
-            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            refreshPushCursor(popCursor);
             if (empty(pushCursorCached_, popCursor)) {
+                popStats_.fail();
                 return popper_t{};
             }
         }
@@ -222,7 +241,291 @@ public:
         return false;
     }
 
+    /// Push one object onto the fifo, blocking while the fifo is full. Spins
+    /// briefly before parking the thread.
+    void pushWait(T const& value) noexcept requires Wait::enabled {
+        futex::spinThenPark([&] { return push(value); }, waiting_.pushWaiting);
+    }
+
+    /// Push one object onto the fifo, blocking for up to `timeout` while
+    /// the fifo is full.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// stayed full.
+    template<typename Rep, typename Period>
+    auto pushWait(T const& value, std::chrono::duration<Rep, Period> timeout) noexcept requires Wait::enabled {
+        auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout);
+        return futex::spinThenPark([&] { return push(value); }, waiting_.pushWaiting, &deadline);
+    }
+
+    /// Pop one object from the fifo, blocking while the fifo is empty. Spins
+    /// briefly before parking the thread.
+    void popWait(T& value) noexcept requires Wait::enabled {
+        futex::spinThenPark([&] { return pop(value); }, waiting_.popWaiting);
+    }
+
+    /// Pop one object from the fifo, blocking for up to `timeout` while the
+    /// fifo is empty.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// stayed empty.
+    template<typename Rep, typename Period>
+    auto popWait(T& value, std::chrono::duration<Rep, Period> timeout) noexcept requires Wait::enabled {
+        auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout);
+        return futex::spinThenPark([&] { return pop(value); }, waiting_.popWaiting, &deadline);
+    }
+
+    /// Push every element of `values` onto the fifo. The elements are
+    /// copied in at most two runs and the push cursor is published once.
+    /// @return `true` if the operation is successful; `false` if there is
+    /// not room for all of `values`, in which case nothing is pushed.
+    auto push(std::span<T const> values) noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (pushable(pushCursor, values.size()) < values.size()) {
+            pushStats_.fail();
+            return false;
+        }
+        if (not values.empty()) {
+            copyToRing(pushCursor, values.data(), values.size());
+            publishPush(pushCursor + values.size());
+        }
+        return true;
+    }
+
+    /// Push as many elements of `values` as will fit onto the fifo with a
+    /// single publish of the push cursor.
+    /// @return the number of elements pushed.
+    auto pushUpTo(std::span<T const> values) noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto count = std::min(values.size(), pushable(pushCursor, values.size()));
+        if (count != 0) {
+            copyToRing(pushCursor, values.data(), count);
+            publishPush(pushCursor + count);
+        } else if (not values.empty()) {
+            pushStats_.fail();
+        }
+        return count;
+    }
+
+    /// Pop `values.size()` elements from the fifo into `values`. The
+    /// elements are copied out in at most two runs and the pop cursor is
+    /// published once.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// holds fewer than `values.size()` elements, in which case nothing is
+    /// popped.
+    auto pop(std::span<T> values) noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (poppable(popCursor, values.size()) < values.size()) {
+            popStats_.fail();
+            return false;
+        }
+        if (not values.empty()) {
+            copyFromRing(popCursor, values.data(), values.size());
+            publishPop(popCursor + values.size());
+        }
+        return true;
+    }
+
+    /// Pop up to `values.size()` elements from the fifo into `values` with
+    /// a single publish of the pop cursor.
+    /// @return the number of elements popped.
+    auto popUpTo(std::span<T> values) noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto count = std::min(values.size(), poppable(popCursor, values.size()));
+        if (count != 0) {
+            copyFromRing(popCursor, values.data(), count);
+            publishPop(popCursor + count);
+        } else if (not values.empty()) {
+            popStats_.fail();
+        }
+        return count;
+    }
+
+    /// An RAII proxy object returned by pushBatch(). Allows the caller to
+    /// fill up to N contiguous slots directly in the fifo's ring. The
+    /// actual push of the committed slots happens, with a single cursor
+    /// publish, when the batch_pusher_t goes out of scope.
+    class batch_pusher_t
+    {
+    public:
+        batch_pusher_t() = default;
+        explicit batch_pusher_t(Fifo5* fifo, size_type cursor, size_type size) noexcept
+            : fifo_{fifo}, cursor_{cursor}, size_{size}, committed_{size} {}
+
+        batch_pusher_t(batch_pusher_t const&) = delete;
+        batch_pusher_t& operator=(batch_pusher_t const&) = delete;
+
+        batch_pusher_t(batch_pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)}
+            , size_{std::move(other.size_)}
+            , committed_{std::move(other.committed_)} {
+            other.release();
+        }
+        batch_pusher_t& operator=(batch_pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            size_ = std::move(other.size_);
+            committed_ = std::move(other.committed_);
+            other.release();
+            return *this;
+        }
+
+        ~batch_pusher_t() {
+            if (fifo_ && committed_ != 0) {
+                fifo_->publishPush(cursor_ + committed_);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// batch_pusher_t goes out of scope. Operations on the
+        /// batch_pusher_t instance after release has been called are
+        /// undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the batch_pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// Push only the first `count` slots of span() when the
+        /// batch_pusher_t goes out of scope. By default all are pushed.
+        void commit(size_type count) noexcept {
+            assert(count <= size_);
+            committed_ = count;
+        }
+
+        /// Returns the number of slots claimed
+        size_type size() const noexcept { return size_; }
+
+        /// @name Direct access to the claimed slots of the fifo's ring
+        ///@{
+        std::span<value_type> span() noexcept { return {fifo_->element(cursor_), size_}; }
+        std::span<value_type const> span() const noexcept { return {fifo_->element(cursor_), size_}; }
+        ///@}
+
+    private:
+        Fifo5* fifo_{};
+        size_type cursor_;
+        size_type size_{};
+        size_type committed_{};
+    };
+    friend class batch_pusher_t;
+
+    /// Optionally claim up to `n` contiguous slots for pushing via a
+    /// batch_pusher_t. The claim is capped by the free space and by the
+    /// end of the ring, so it may be smaller than `n`.
+    /// @return a batch_pusher_t, inactive if the fifo is full.
+    batch_pusher_t pushBatch(size_type n) noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto wanted = std::min(n, contiguous(pushCursor));
+        auto count = std::min(wanted, pushable(pushCursor, wanted));
+        if (count == 0) {
+            pushStats_.fail();
+            return batch_pusher_t{};
+        }
+        return batch_pusher_t(this, pushCursor, count);
+    }
+
+    /// An RAII proxy object returned by popBatch(). Allows the caller to
+    /// process up to N contiguous elements directly in the fifo's ring. The
+    /// actual pop of the committed elements happens, with a single cursor
+    /// publish, when the batch_popper_t goes out of scope.
+    class batch_popper_t
+    {
+    public:
+        batch_popper_t() = default;
+        explicit batch_popper_t(Fifo5* fifo, size_type cursor, size_type size) noexcept
+            : fifo_{fifo}, cursor_{cursor}, size_{size}, committed_{size} {}
+
+        batch_popper_t(batch_popper_t const&) = delete;
+        batch_popper_t& operator=(batch_popper_t const&) = delete;
+
+        batch_popper_t(batch_popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)}
+            , size_{std::move(other.size_)}
+            , committed_{std::move(other.committed_)} {
+            other.release();
+        }
+        batch_popper_t& operator=(batch_popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            size_ = std::move(other.size_);
+            committed_ = std::move(other.committed_);
+            other.release();
+            return *this;
+        }
+
+        ~batch_popper_t() {
+            if (fifo_ && committed_ != 0) {
+                fifo_->publishPop(cursor_ + committed_);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// batch_popper_t goes out of scope. Operations on the
+        /// batch_popper_t instance after release has been called are
+        /// undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the batch_popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// Pop only the first `count` elements of span() when the
+        /// batch_popper_t goes out of scope. By default all are popped.
+        void commit(size_type count) noexcept {
+            assert(count <= size_);
+            committed_ = count;
+        }
+
+        /// Returns the number of elements claimed
+        size_type size() const noexcept { return size_; }
+
+        /// @name Direct access to the claimed elements in the fifo's ring
+        ///@{
+        std::span<value_type> span() noexcept { return {fifo_->element(cursor_), size_}; }
+        std::span<value_type const> span() const noexcept { return {fifo_->element(cursor_), size_}; }
+        ///@}
+
+    private:
+        Fifo5* fifo_{};
+        size_type cursor_;
+        size_type size_{};
+        size_type committed_{};
+    };
+    friend class batch_popper_t;
+
+    /// Optionally claim up to `n` contiguous elements for popping via a
+    /// batch_popper_t. The claim is capped by the number of elements in the
+    /// fifo and by the end of the ring, so it may be smaller than `n`.
+    /// @return a batch_popper_t, inactive if the fifo is empty.
+    batch_popper_t popBatch(size_type n) noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto wanted = std::min(n, contiguous(popCursor));
+        auto count = std::min(wanted, poppable(popCursor, wanted));
+        if (count == 0) {
+            popStats_.fail();
+            return batch_popper_t{};
+        }
+        return batch_popper_t(this, popCursor, count);
+    }
+
 private:
+    /// Store the push cursor and wake the pop thread if it is parked
+    void publishPush(size_type pushCursor) noexcept {
+        pushCursor_.store(pushCursor, std::memory_order_release);
+        if constexpr (Wait::enabled) {
+            futex::wakeIfWaiting(waiting_.popWaiting);
+        }
+    }
+
+    /// Store the pop cursor and wake the push thread if it is parked
+    void publishPop(size_type popCursor) noexcept {
+        popCursor_.store(popCursor, std::memory_order_release);
+        if constexpr (Wait::enabled) {
+            futex::wakeIfWaiting(waiting_.pushWaiting);
+        }
+    }
+
     auto full(size_type pushCursor, size_type popCursor) const noexcept {
         assert(popCursor <= pushCursor);
         return (pushCursor - popCursor) == capacity();
@@ -231,6 +534,57 @@ private:
         return pushCursor == popCursor;
     }
 
+    /// Reload popCursorCached_ from the pop thread's cursor
+    void refreshPopCursor(size_type pushCursor) noexcept {
+        popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+        pushStats_.refresh(pushCursor - popCursorCached_);
+    }
+
+    /// Reload pushCursorCached_ from the push thread's cursor
+    void refreshPushCursor(size_type popCursor) noexcept {
+        pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+        popStats_.refresh(pushCursorCached_ - popCursor);
+    }
+
+    /// Returns the number of free slots, refreshing popCursorCached_ only
+    /// if fewer than `wanted` appear to be free.
+    auto pushable(size_type pushCursor, size_type wanted) noexcept {
+        if (capacity() - (pushCursor - popCursorCached_) < wanted) {
+            refreshPopCursor(pushCursor);
+        }
+        assert(popCursorCached_ <= pushCursor);
+        return capacity() - (pushCursor - popCursorCached_);
+    }
+
+    /// Returns the number of filled slots, refreshing pushCursorCached_
+    /// only if fewer than `wanted` appear to be filled.
+    auto poppable(size_type popCursor, size_type wanted) noexcept {
+        if (pushCursorCached_ - popCursor < wanted) {
+            refreshPushCursor(popCursor);
+        }
+        assert(popCursor <= pushCursorCached_);
+        return pushCursorCached_ - popCursor;
+    }
+
+    /// Copy `count` elements into the ring starting at `cursor`, splitting
+    /// the copy in two where the ring wraps.
+    void copyToRing(size_type cursor, T const* values, size_type count) noexcept {
+        auto first = std::min(count, contiguous(cursor));
+        std::memcpy(element(cursor), values, first * sizeof(T));
+        std::memcpy(ring_, values + first, (count - first) * sizeof(T));
+    }
+
+    /// Copy `count` elements out of the ring starting at `cursor`, splitting
+    /// the copy in two where the ring wraps.
+    void copyFromRing(size_type cursor, T* values, size_type count) const noexcept {
+        auto first = std::min(count, contiguous(cursor));
+        std::memcpy(values, element(cursor), first * sizeof(T));
+        std::memcpy(values + first, ring_, (count - first) * sizeof(T));
+    }
+
+    /// Returns the number of slots from `cursor` to the end of the ring
+    auto contiguous(size_type cursor) const noexcept { return capacity() - (cursor % capacity_); }
+
     auto* element(size_type cursor) noexcept { return &ring_[cursor % capacity_]; }
     auto const* element(size_type cursor) const noexcept { return &ring_[cursor % capacity_]; }
 
@@ -243,20 +597,27 @@ private:
 
     // https://stackoverflow.com/questions/39680206/understanding-stdhardware-destructive-interference-size-and-stdhardware-cons
     // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
-    static constexpr auto hardware_destructive_interference_size = size_type{64};
+    static constexpr auto hardware_destructive_interference_size = size_type{Layout::lineSize};
+    static constexpr auto cachedCursorAlignment = Layout::separateCachedCursors
+        ? hardware_destructive_interference_size : size_type{alignof(size_type)};
 
     /// Loaded and stored by the push thread; loaded by the pop thread
     alignas(hardware_destructive_interference_size) CursorType pushCursor_;
 
     /// Exclusive to the push thread
-    alignas(hardware_destructive_interference_size) size_type popCursorCached_{};
+    alignas(cachedCursorAlignment) size_type popCursorCached_{};
+    [[no_unique_address]] typename Stats::Side pushStats_;
 
     /// Loaded and stored by the pop thread; loaded by the push thread
     alignas(hardware_destructive_interference_size) CursorType popCursor_;
 
     /// Exclusive to the pop thread
-    alignas(hardware_destructive_interference_size) size_type pushCursorCached_{};
+    alignas(cachedCursorAlignment) size_type pushCursorCached_{};
+    [[no_unique_address]] typename Stats::Side popStats_;
+
+    /// Only with FutexWait, the flags set by a parked thread
+    [[no_unique_address]] typename Wait::template Flags<hardware_destructive_interference_size> waiting_;
 
-    // Padding to avoid false sharing with adjacent objects
-    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+    // The alignment of the members above pads the fifo to whole lines,
+    // avoiding false sharing with adjacent objects
 };
@@ -2,17 +2,24 @@
 
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <memory>
 #include <new>
 #include <type_traits>
 
+#include "FifoLayout.hpp"
 // For ValueSizeTraits
 #include "Fifo5.hpp"
+#include "FifoWait.hpp"
 
 
 /// Like Fifo5a except uses atomic_ref
-template<typename T, typename Alloc = std::allocator<T>>
+///
+/// @tparam Layout cursor layout policy; see FifoLayout.hpp
+/// @tparam Wait blocking policy; FutexWait adds pushWait() and popWait()
+template<typename T, typename Alloc = std::allocator<T>, typename Layout = Padded64Layout, typename Wait = NoWait>
     requires std::is_trivial_v<T>
 class Fifo5b : private Alloc
 {
@@ -28,6 +35,13 @@ public:
         assert((capacity & mask_) == 0);
     }
 
+    // std::atomic_ref is copyable so, unlike the other fifos, these are not
+    // implicitly deleted
+    Fifo5b(Fifo5b const&) = delete;
+    Fifo5b& operator=(Fifo5b const&) = delete;
+    Fifo5b(Fifo5b&&) = delete;
+    Fifo5b& operator=(Fifo5b&&) = delete;
+
     ~Fifo5b() {
         allocator_traits::deallocate(*this, ring_, capacity());
     }
@@ -78,7 +92,7 @@ public:
 
         ~pusher_t() {
             if (fifo_) {
-                fifo_->pushCursorRef_.store(cursor_ + 1, std::memory_order_release);
+                fifo_->publishPush(cursor_ + 1);
             }
         }
 
@@ -166,7 +180,7 @@ public:
 
         ~popper_t() {
             if (fifo_) {
-                fifo_->popCursorRef_.store(cursor_ + 1, std::memory_order_release);
+                fifo_->publishPop(cursor_ + 1);
             }
         }
 
@@ -217,7 +231,57 @@ public:
         return false;
     }
 
+    /// Push one object onto the fifo, blocking while the fifo is full. Spins
+    /// briefly before parking the thread.
+    void pushWait(T const& value) noexcept requires Wait::enabled {
+        futex::spinThenPark([&] { return push(value); }, waiting_.pushWaiting);
+    }
+
+    /// Push one object onto the fifo, blocking for up to `timeout` while
+    /// the fifo is full.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// stayed full.
+    template<typename Rep, typename Period>
+    auto pushWait(T const& value, std::chrono::duration<Rep, Period> timeout) noexcept requires Wait::enabled {
+        auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout);
+        return futex::spinThenPark([&] { return push(value); }, waiting_.pushWaiting, &deadline);
+    }
+
+    /// Pop one object from the fifo, blocking while the fifo is empty. Spins
+    /// briefly before parking the thread.
+    void popWait(T& value) noexcept requires Wait::enabled {
+        futex::spinThenPark([&] { return pop(value); }, waiting_.popWaiting);
+    }
+
+    /// Pop one object from the fifo, blocking for up to `timeout` while the
+    /// fifo is empty.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// stayed empty.
+    template<typename Rep, typename Period>
+    auto popWait(T& value, std::chrono::duration<Rep, Period> timeout) noexcept requires Wait::enabled {
+        auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout);
+        return futex::spinThenPark([&] { return pop(value); }, waiting_.popWaiting, &deadline);
+    }
+
 private:
+    /// Store the push cursor and wake the pop thread if it is parked
+    void publishPush(size_type pushCursor) noexcept {
+        pushCursorRef_.store(pushCursor, std::memory_order_release);
+        if constexpr (Wait::enabled) {
+            futex::wakeIfWaiting(waiting_.popWaiting);
+        }
+    }
+
+    /// Store the pop cursor and wake the push thread if it is parked
+    void publishPop(size_type popCursor) noexcept {
+        popCursorRef_.store(popCursor, std::memory_order_release);
+        if constexpr (Wait::enabled) {
+            futex::wakeIfWaiting(waiting_.pushWaiting);
+        }
+    }
+
     auto full(size_type pushCursor, size_type popCursor) const noexcept {
         assert(popCursor <= pushCursor);
         return (pushCursor - popCursor) == capacity();
@@ -238,22 +302,27 @@ private:
 
     // https://stackoverflow.com/questions/39680206/understanding-stdhardware-destructive-interference-size-and-stdhardware-cons
     // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
-    static constexpr auto hardware_destructive_interference_size = size_type{64};
+    static constexpr auto hardware_destructive_interference_size = size_type{Layout::lineSize};
+    static constexpr auto cachedCursorAlignment = Layout::separateCachedCursors
+        ? hardware_destructive_interference_size : size_type{alignof(size_type)};
 
     /// Loaded and stored by the push thread; loaded by the pop thread
     alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
     CursorRefType pushCursorRef_{pushCursor_};
 
     /// Exclusive to the push thread
-    alignas(hardware_destructive_interference_size) size_type popCursorCached_{};
+    alignas(cachedCursorAlignment) size_type popCursorCached_{};
 
     /// Loaded and stored by the pop thread; loaded by the push thread
     alignas(hardware_destructive_interference_size) CursorType popCursor_{};
     CursorRefType popCursorRef_{popCursor_};
 
     /// Exclusive to the pop thread
-    alignas(hardware_destructive_interference_size) size_type pushCursorCached_{};
+    alignas(cachedCursorAlignment) size_type pushCursorCached_{};
+
+    /// Only with FutexWait, the flags set by a parked thread
+    [[no_unique_address]] typename Wait::template Flags<hardware_destructive_interference_size> waiting_;
 
-    // Padding to avoid false sharing with adjacent objects
-    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+    // The alignment of the members above pads the fifo to whole lines,
+    // avoiding false sharing with adjacent objects
 };
@@ -0,0 +1,583 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <span>
+#include <type_traits>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+#include "FifoWait.hpp"
+
+
+/// Like Fifo5a except the capacity is a template parameter and the ring is
+/// stored inline so indexing needs neither a mask_ load nor a ring_ load
+///
+/// @tparam Wait blocking policy; FutexWait adds pushWait() and popWait()
+template<typename T, std::size_t Capacity, typename Wait = NoWait>
+    requires std::is_trivial_v<T> && (Capacity != 0) && ((Capacity & (Capacity - 1)) == 0)
+class Fifo5c
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    /// @param capacity must equal `Capacity`; taken for compatibility with
+    /// the other fifos' constructors
+    explicit Fifo5c(size_type capacity) noexcept {
+        assert(capacity == Capacity);
+    }
+
+    // For consistency with other fifos
+    Fifo5c(Fifo5c const&) = delete;
+    Fifo5c& operator=(Fifo5c const&) = delete;
+    Fifo5c(Fifo5c&&) = delete;
+    Fifo5c& operator=(Fifo5c&&) = delete;
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    static constexpr auto capacity() noexcept { return Capacity; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(Fifo5c* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                fifo_->publishPush(cursor_ + 1);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        Fifo5c* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (full(pushCursor, popCursorCached_)) {
+            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+            if (full(pushCursor, popCursorCached_)) {
+                return pusher_t{};
+            }
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's ring. The
+    // /actual pop happens when the popper goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(Fifo5c* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                fifo_->publishPop(cursor_ + 1);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        Fifo5c* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    auto pop() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursorCached_, popCursor)) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (empty(pushCursorCached_, popCursor)) {
+                return popper_t{};
+            }
+        }
+        return popper_t(this, popCursor);
+    };
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+    /// Push one object onto the fifo, blocking while the fifo is full. Spins
+    /// briefly before parking the thread.
+    void pushWait(T const& value) noexcept requires Wait::enabled {
+        futex::spinThenPark([&] { return push(value); }, waiting_.pushWaiting);
+    }
+
+    /// Push one object onto the fifo, blocking for up to `timeout` while
+    /// the fifo is full.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// stayed full.
+    template<typename Rep, typename Period>
+    auto pushWait(T const& value, std::chrono::duration<Rep, Period> timeout) noexcept requires Wait::enabled {
+        auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout);
+        return futex::spinThenPark([&] { return push(value); }, waiting_.pushWaiting, &deadline);
+    }
+
+    /// Pop one object from the fifo, blocking while the fifo is empty. Spins
+    /// briefly before parking the thread.
+    void popWait(T& value) noexcept requires Wait::enabled {
+        futex::spinThenPark([&] { return pop(value); }, waiting_.popWaiting);
+    }
+
+    /// Pop one object from the fifo, blocking for up to `timeout` while the
+    /// fifo is empty.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// stayed empty.
+    template<typename Rep, typename Period>
+    auto popWait(T& value, std::chrono::duration<Rep, Period> timeout) noexcept requires Wait::enabled {
+        auto deadline = std::chrono::steady_clock::now()
+            + std::chrono::ceil<std::chrono::steady_clock::duration>(timeout);
+        return futex::spinThenPark([&] { return pop(value); }, waiting_.popWaiting, &deadline);
+    }
+
+    /// Push every element of `values` onto the fifo. The elements are
+    /// copied in at most two runs and the push cursor is published once.
+    /// @return `true` if the operation is successful; `false` if there is
+    /// not room for all of `values`, in which case nothing is pushed.
+    auto push(std::span<T const> values) noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (pushable(pushCursor, values.size()) < values.size()) {
+            return false;
+        }
+        if (not values.empty()) {
+            copyToRing(pushCursor, values.data(), values.size());
+            publishPush(pushCursor + values.size());
+        }
+        return true;
+    }
+
+    /// Push as many elements of `values` as will fit onto the fifo with a
+    /// single publish of the push cursor.
+    /// @return the number of elements pushed.
+    auto pushUpTo(std::span<T const> values) noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto count = std::min(values.size(), pushable(pushCursor, values.size()));
+        if (count != 0) {
+            copyToRing(pushCursor, values.data(), count);
+            publishPush(pushCursor + count);
+        }
+        return count;
+    }
+
+    /// Pop `values.size()` elements from the fifo into `values`. The
+    /// elements are copied out in at most two runs and the pop cursor is
+    /// published once.
+    /// @return `true` if the operation is successful; `false` if the fifo
+    /// holds fewer than `values.size()` elements, in which case nothing is
+    /// popped.
+    auto pop(std::span<T> values) noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (poppable(popCursor, values.size()) < values.size()) {
+            return false;
+        }
+        if (not values.empty()) {
+            copyFromRing(popCursor, values.data(), values.size());
+            publishPop(popCursor + values.size());
+        }
+        return true;
+    }
+
+    /// Pop up to `values.size()` elements from the fifo into `values` with
+    /// a single publish of the pop cursor.
+    /// @return the number of elements popped.
+    auto popUpTo(std::span<T> values) noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto count = std::min(values.size(), poppable(popCursor, values.size()));
+        if (count != 0) {
+            copyFromRing(popCursor, values.data(), count);
+            publishPop(popCursor + count);
+        }
+        return count;
+    }
+
+    /// An RAII proxy object returned by pushBatch(). Allows the caller to
+    /// fill up to N contiguous slots directly in the fifo's ring. The
+    /// actual push of the committed slots happens, with a single cursor
+    /// publish, when the batch_pusher_t goes out of scope.
+    class batch_pusher_t
+    {
+    public:
+        batch_pusher_t() = default;
+        explicit batch_pusher_t(Fifo5c* fifo, size_type cursor, size_type size) noexcept
+            : fifo_{fifo}, cursor_{cursor}, size_{size}, committed_{size} {}
+
+        batch_pusher_t(batch_pusher_t const&) = delete;
+        batch_pusher_t& operator=(batch_pusher_t const&) = delete;
+
+        batch_pusher_t(batch_pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)}
+            , size_{std::move(other.size_)}
+            , committed_{std::move(other.committed_)} {
+            other.release();
+        }
+        batch_pusher_t& operator=(batch_pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            size_ = std::move(other.size_);
+            committed_ = std::move(other.committed_);
+            other.release();
+            return *this;
+        }
+
+        ~batch_pusher_t() {
+            if (fifo_ && committed_ != 0) {
+                fifo_->publishPush(cursor_ + committed_);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// batch_pusher_t goes out of scope. Operations on the
+        /// batch_pusher_t instance after release has been called are
+        /// undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the batch_pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// Push only the first `count` slots of span() when the
+        /// batch_pusher_t goes out of scope. By default all are pushed.
+        void commit(size_type count) noexcept {
+            assert(count <= size_);
+            committed_ = count;
+        }
+
+        /// Returns the number of slots claimed
+        size_type size() const noexcept { return size_; }
+
+        /// @name Direct access to the claimed slots of the fifo's ring
+        ///@{
+        std::span<value_type> span() noexcept { return {fifo_->element(cursor_), size_}; }
+        std::span<value_type const> span() const noexcept { return {fifo_->element(cursor_), size_}; }
+        ///@}
+
+    private:
+        Fifo5c* fifo_{};
+        size_type cursor_;
+        size_type size_{};
+        size_type committed_{};
+    };
+    friend class batch_pusher_t;
+
+    /// Optionally claim up to `n` contiguous slots for pushing via a
+    /// batch_pusher_t. The claim is capped by the free space and by the
+    /// end of the ring, so it may be smaller than `n`.
+    /// @return a batch_pusher_t, inactive if the fifo is full.
+    batch_pusher_t pushBatch(size_type n) noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto wanted = std::min(n, contiguous(pushCursor));
+        auto count = std::min(wanted, pushable(pushCursor, wanted));
+        if (count == 0) {
+            return batch_pusher_t{};
+        }
+        return batch_pusher_t(this, pushCursor, count);
+    }
+
+    /// An RAII proxy object returned by popBatch(). Allows the caller to
+    /// process up to N contiguous elements directly in the fifo's ring. The
+    /// actual pop of the committed elements happens, with a single cursor
+    /// publish, when the batch_popper_t goes out of scope.
+    class batch_popper_t
+    {
+    public:
+        batch_popper_t() = default;
+        explicit batch_popper_t(Fifo5c* fifo, size_type cursor, size_type size) noexcept
+            : fifo_{fifo}, cursor_{cursor}, size_{size}, committed_{size} {}
+
+        batch_popper_t(batch_popper_t const&) = delete;
+        batch_popper_t& operator=(batch_popper_t const&) = delete;
+
+        batch_popper_t(batch_popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)}
+            , size_{std::move(other.size_)}
+            , committed_{std::move(other.committed_)} {
+            other.release();
+        }
+        batch_popper_t& operator=(batch_popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            size_ = std::move(other.size_);
+            committed_ = std::move(other.committed_);
+            other.release();
+            return *this;
+        }
+
+        ~batch_popper_t() {
+            if (fifo_ && committed_ != 0) {
+                fifo_->publishPop(cursor_ + committed_);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// batch_popper_t goes out of scope. Operations on the
+        /// batch_popper_t instance after release has been called are
+        /// undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the batch_popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// Pop only the first `count` elements of span() when the
+        /// batch_popper_t goes out of scope. By default all are popped.
+        void commit(size_type count) noexcept {
+            assert(count <= size_);
+            committed_ = count;
+        }
+
+        /// Returns the number of elements claimed
+        size_type size() const noexcept { return size_; }
+
+        /// @name Direct access to the claimed elements in the fifo's ring
+        ///@{
+        std::span<value_type> span() noexcept { return {fifo_->element(cursor_), size_}; }
+        std::span<value_type const> span() const noexcept { return {fifo_->element(cursor_), size_}; }
+        ///@}
+
+    private:
+        Fifo5c* fifo_{};
+        size_type cursor_;
+        size_type size_{};
+        size_type committed_{};
+    };
+    friend class batch_popper_t;
+
+    /// Optionally claim up to `n` contiguous elements for popping via a
+    /// batch_popper_t. The claim is capped by the number of elements in the
+    /// fifo and by the end of the ring, so it may be smaller than `n`.
+    /// @return a batch_popper_t, inactive if the fifo is empty.
+    batch_popper_t popBatch(size_type n) noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto wanted = std::min(n, contiguous(popCursor));
+        auto count = std::min(wanted, poppable(popCursor, wanted));
+        if (count == 0) {
+            return batch_popper_t{};
+        }
+        return batch_popper_t(this, popCursor, count);
+    }
+
+private:
+    /// Store the push cursor and wake the pop thread if it is parked
+    void publishPush(size_type pushCursor) noexcept {
+        pushCursor_.store(pushCursor, std::memory_order_release);
+        if constexpr (Wait::enabled) {
+            futex::wakeIfWaiting(waiting_.popWaiting);
+        }
+    }
+
+    /// Store the pop cursor and wake the push thread if it is parked
+    void publishPop(size_type popCursor) noexcept {
+        popCursor_.store(popCursor, std::memory_order_release);
+        if constexpr (Wait::enabled) {
+            futex::wakeIfWaiting(waiting_.pushWaiting);
+        }
+    }
+
+    auto full(size_type pushCursor, size_type popCursor) const noexcept {
+        assert(popCursor <= pushCursor);
+        return (pushCursor - popCursor) == capacity();
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    /// Returns the number of free slots, refreshing popCursorCached_ only
+    /// if fewer than `wanted` appear to be free.
+    auto pushable(size_type pushCursor, size_type wanted) noexcept {
+        if (capacity() - (pushCursor - popCursorCached_) < wanted) {
+            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+        }
+        assert(popCursorCached_ <= pushCursor);
+        return capacity() - (pushCursor - popCursorCached_);
+    }
+
+    /// Returns the number of filled slots, refreshing pushCursorCached_
+    /// only if fewer than `wanted` appear to be filled.
+    auto poppable(size_type popCursor, size_type wanted) noexcept {
+        if (pushCursorCached_ - popCursor < wanted) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+        }
+        assert(popCursor <= pushCursorCached_);
+        return pushCursorCached_ - popCursor;
+    }
+
+    /// Copy `count` elements into the ring starting at `cursor`, splitting
+    /// the copy in two where the ring wraps.
+    void copyToRing(size_type cursor, T const* values, size_type count) noexcept {
+        auto first = std::min(count, contiguous(cursor));
+        std::memcpy(element(cursor), values, first * sizeof(T));
+        std::memcpy(ring_, values + first, (count - first) * sizeof(T));
+    }
+
+    /// Copy `count` elements out of the ring starting at `cursor`, splitting
+    /// the copy in two where the ring wraps.
+    void copyFromRing(size_type cursor, T* values, size_type count) const noexcept {
+        auto first = std::min(count, contiguous(cursor));
+        std::memcpy(values, element(cursor), first * sizeof(T));
+        std::memcpy(values + first, ring_, (count - first) * sizeof(T));
+    }
+
+    /// Returns the number of slots from `cursor` to the end of the ring
+    auto contiguous(size_type cursor) const noexcept { return capacity() - (cursor & mask); }
+
+    auto* element(size_type cursor) noexcept { return &ring_[cursor & mask]; }
+    auto const* element(size_type cursor) const noexcept { return &ring_[cursor & mask]; }
+
+private:
+    static constexpr auto mask = Capacity - 1;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // https://stackoverflow.com/questions/39680206/understanding-stdhardware-destructive-interference-size-and-stdhardware-cons
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_;
+
+    /// Exclusive to the push thread
+    alignas(hardware_destructive_interference_size) size_type popCursorCached_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_;
+
+    /// Exclusive to the pop thread
+    alignas(hardware_destructive_interference_size) size_type pushCursorCached_{};
+
+    /// Only with FutexWait, the flags set by a parked thread
+    [[no_unique_address]] typename Wait::template Flags<hardware_destructive_interference_size> waiting_;
+
+    /// The ring starts on its own cache line. The class's alignment pads
+    /// its end to avoid false sharing with adjacent objects.
+    alignas(hardware_destructive_interference_size) T ring_[Capacity];
+};
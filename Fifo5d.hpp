@@ -0,0 +1,311 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// Fifo5a with deferred cursor publication. Each thread advances a private
+/// copy of its cursor and publishes it, with the release store that sends
+/// the cursor's cache line to the other core, only every PushBatch pushes
+/// or PopBatch pops, on flushPush() or flushPop(), or when it finds the
+/// fifo full or empty respectively. During a burst this replaces one cache
+/// line transfer per element with one per batch.
+///
+/// Staleness is bounded: at most PushBatch - 1 pushed elements are hidden
+/// from the pop thread, and none once the push thread has called
+/// flushPush() or found the fifo full. Likewise at most PopBatch - 1 freed
+/// slots are hidden from the push thread. A push thread that stops short
+/// of a batch must call flushPush(), and a pop thread flushPop(), for the
+/// other thread to see the last elements.
+///
+/// size(), empty() and full() report the published cursors. With the
+/// default batches of 1 Fifo5d behaves as Fifo5a.
+template<typename T, std::size_t PushBatch = 1, std::size_t PopBatch = 1, typename Alloc = std::allocator<T>>
+    requires std::is_trivial_v<T> && (PushBatch > 0) && (PopBatch > 0)
+class Fifo5d : private Alloc
+{
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit Fifo5d(size_type capacity, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , mask_{capacity - 1}
+        , ring_{allocator_traits::allocate(*this, capacity)} {
+        assert((capacity & mask_) == 0);
+    }
+
+    ~Fifo5d() {
+        allocator_traits::deallocate(*this, ring_, capacity());
+    }
+
+
+    /// Returns the number of published elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope; it is
+    /// published with the rest of its batch.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(Fifo5d* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                fifo_->pushed(cursor_ + 1);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        Fifo5d* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher. Publishes the
+    /// push cursor if the fifo is full.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursorLocal_;
+        if (full(pushCursor, popCursorCached_)) {
+            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+            if (full(pushCursor, popCursorCached_)) {
+                flushPush();
+                return pusher_t{};
+            }
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// Publish every push so far to the pop thread. Only the push thread
+    /// may call this.
+    void flushPush() noexcept {
+        if (pushCursor_.load(std::memory_order_relaxed) != pushCursorLocal_) {
+            pushCursor_.store(pushCursorLocal_, std::memory_order_release);
+        }
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's ring. The
+    /// actual pop happens when the popper goes out of scope; it is
+    /// published with the rest of its batch.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(Fifo5d* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                fifo_->popped(cursor_ + 1);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        Fifo5d* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    /// Optionally pop one object via a popper. Publishes the pop cursor if
+    /// the fifo is empty.
+    auto pop() noexcept {
+        auto popCursor = popCursorLocal_;
+        if (empty(pushCursorCached_, popCursor)) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (empty(pushCursorCached_, popCursor)) {
+                flushPop();
+                return popper_t{};
+            }
+        }
+        return popper_t(this, popCursor);
+    };
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+    /// Publish every pop so far to the push thread. Only the pop thread may
+    /// call this.
+    void flushPop() noexcept {
+        if (popCursor_.load(std::memory_order_relaxed) != popCursorLocal_) {
+            popCursor_.store(popCursorLocal_, std::memory_order_release);
+        }
+    }
+
+private:
+    /// Advance the private push cursor, publishing it at the end of a batch
+    void pushed(size_type pushCursor) noexcept {
+        pushCursorLocal_ = pushCursor;
+        if (pushCursor - pushCursor_.load(std::memory_order_relaxed) >= PushBatch) {
+            pushCursor_.store(pushCursor, std::memory_order_release);
+        }
+    }
+
+    /// Advance the private pop cursor, publishing it at the end of a batch
+    void popped(size_type popCursor) noexcept {
+        popCursorLocal_ = popCursor;
+        if (popCursor - popCursor_.load(std::memory_order_relaxed) >= PopBatch) {
+            popCursor_.store(popCursor, std::memory_order_release);
+        }
+    }
+
+    auto full(size_type pushCursor, size_type popCursor) const noexcept {
+        assert(popCursor <= pushCursor);
+        return (pushCursor - popCursor) == capacity();
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    auto* element(size_type cursor) noexcept { return &ring_[cursor & mask_]; }
+    auto const* element(size_type cursor) const noexcept { return &ring_[cursor & mask_]; }
+
+private:
+    size_type mask_;
+    T* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Published by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    alignas(hardware_destructive_interference_size) size_type pushCursorLocal_{};
+    size_type popCursorCached_{};
+
+    /// Published by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Exclusive to the pop thread
+    alignas(hardware_destructive_interference_size) size_type popCursorLocal_{};
+    size_type pushCursorCached_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - 2*sizeof(size_type)];
+};
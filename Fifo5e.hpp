@@ -0,0 +1,318 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+
+/// Fifo5a's pusher and popper for any T, including move-only types and
+/// types that own memory. Elements are constructed in place in the ring,
+/// by emplace(), push(T&&) or a pusher, and destroyed in place once popped,
+/// so moving a message through the fifo needs no copies and, for types
+/// such as std::string and std::unique_ptr, no allocations.
+template<typename T, typename Alloc = std::allocator<T>>
+    requires std::is_nothrow_destructible_v<T>
+class Fifo5e : private Alloc
+{
+public:
+    using value_type = T;
+    using allocator_traits = std::allocator_traits<Alloc>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit Fifo5e(size_type capacity, Alloc const& alloc = Alloc{})
+        : Alloc{alloc}
+        , mask_{capacity - 1}
+        , ring_{allocator_traits::allocate(*this, capacity)} {
+        assert((capacity & mask_) == 0);
+    }
+
+    // The destructor destroys the elements left in the ring, so a copy
+    // would destroy them twice
+    Fifo5e(Fifo5e const&) = delete;
+    Fifo5e& operator=(Fifo5e const&) = delete;
+    Fifo5e(Fifo5e&&) = delete;
+    Fifo5e& operator=(Fifo5e&&) = delete;
+
+    ~Fifo5e() {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        for (auto cursor = popCursor_.load(std::memory_order_relaxed); cursor != pushCursor; ++cursor) {
+            std::destroy_at(element(cursor));
+        }
+        allocator_traits::deallocate(*this, ring_, capacity());
+    }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+
+    /// An RAII proxy object returned by push(). Holds a free slot in the
+    /// fifo's ring in which the caller constructs the element with
+    /// emplace() or assignment. The actual push happens when the pusher
+    /// goes out of scope, and only if an element was constructed.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(Fifo5e* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)}
+            , constructed_{std::move(other.constructed_)} {
+            other.fifo_ = {};
+        }
+        /// Any element constructed in this pusher's slot is destroyed, not
+        /// pushed
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            release();
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            constructed_ = std::move(other.constructed_);
+            other.fifo_ = {};
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_ && constructed_) {
+                fifo_->pushCursor_.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope and any element constructed is
+        /// destroyed. Operations on the pusher_t instance after release
+        /// has been called are undefined.
+        void release() noexcept {
+            if (fifo_ && constructed_) {
+                std::destroy_at(get());
+            }
+            fifo_ = {};
+        }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// Construct the element in the slot from `args`. May be called
+        /// once. If the constructor throws nothing is pushed.
+        template<typename... Args>
+        value_type& emplace(Args&&... args) {
+            assert(not constructed_);
+            auto* value = std::construct_at(fifo_->element(cursor_), std::forward<Args>(args)...);
+            constructed_ = true;
+            return *value;
+        }
+
+        /// Construct the element in the slot from `value`, or assign to it
+        /// if already constructed.
+        ///@{
+        pusher_t& operator=(value_type const& value) {
+            assign(value);
+            return *this;
+        }
+        pusher_t& operator=(value_type&& value) {
+            assign(std::move(value));
+            return *this;
+        }
+        ///@}
+
+        /// @name Direct access to the element once constructed
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        template<typename U>
+        void assign(U&& value) {
+            if (constructed_) {
+                *get() = std::forward<U>(value);
+            } else {
+                emplace(std::forward<U>(value));
+            }
+        }
+
+    private:
+        Fifo5e* fifo_{};
+        size_type cursor_;
+        bool constructed_{};
+    };
+    friend class pusher_t;
+
+    /// Optionally claim a free slot via a pusher.
+    /// @return a pusher_t, inactive if the fifo is full.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (full(pushCursor, popCursorCached_)) {
+            popCursorCached_ = popCursor_.load(std::memory_order_acquire);
+            if (full(pushCursor, popCursorCached_)) {
+                return pusher_t{};
+            }
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Construct one object in place at the back of the fifo from `args`.
+    /// @return `true` if the operation is successful; `false` if fifo is
+    /// full, in which case `args` are untouched.
+    template<typename... Args>
+    bool emplace(Args&&... args) {
+        if (auto pusher = push(); pusher) {
+            pusher.emplace(std::forward<Args>(args)...);
+            return true;
+        }
+        return false;
+    }
+
+    /// Push one object onto the fifo, copying it.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    bool push(T const& value) { return emplace(value); }
+
+    /// Push one object onto the fifo, moving from it only if successful.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    bool push(T&& value) { return emplace(std::move(value)); }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to use or
+    /// move from the element directly in the fifo's ring. The element is
+    /// destroyed in place, and the actual pop happens, when the popper
+    /// goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(Fifo5e* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                std::destroy_at(get());
+                fifo_->popCursor_.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the element is neither destroyed nor popped when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        Fifo5e* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    /// Optionally pop one object via a popper
+    auto pop() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursorCached_, popCursor)) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (empty(pushCursorCached_, popCursor)) {
+                return popper_t{};
+            }
+        }
+        return popper_t(this, popCursor);
+    };
+
+    /// Pop one object from the fifo by moving it into `value`.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept(std::is_nothrow_move_assignable_v<T>) {
+        if (auto popper = pop(); popper) {
+            value = std::move(*popper);
+            return true;
+        }
+        return false;
+    }
+
+private:
+    auto full(size_type pushCursor, size_type popCursor) const noexcept {
+        assert(popCursor <= pushCursor);
+        return (pushCursor - popCursor) == capacity();
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    auto* element(size_type cursor) noexcept { return &ring_[cursor & mask_]; }
+    auto const* element(size_type cursor) const noexcept { return &ring_[cursor & mask_]; }
+
+private:
+    size_type mask_;
+    T* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    alignas(hardware_destructive_interference_size) size_type popCursorCached_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Exclusive to the pop thread
+    alignas(hardware_destructive_interference_size) size_type pushCursorCached_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+};
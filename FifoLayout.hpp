@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+
+
+/// Cursor layout policies for Fifo3 to Fifo5b. Each side of a fifo has a
+/// cursor, stored by its own thread and loaded by the other, and a cached
+/// copy of the other side's cursor that only its own thread touches. The
+/// fifos align each group of members to `lineSize`, which also pads the
+/// fifo to whole lines so that adjacent objects never share them.
+
+
+/// Each side's cursor and cached cursor share one line. The other thread's
+/// loads of the cursor fetch the cached cursor with it, but both are
+/// written only by the owning thread, so this costs no extra line
+/// transfers and halves the cursors' footprint.
+struct CompactLayout
+{
+    static constexpr std::size_t lineSize = 64;
+    static constexpr bool separateCachedCursors = false;
+};
+
+/// Every cursor and cached cursor on a line of its own of `LineSize`
+/// bytes. Intel's adjacent-line prefetcher fetches 64 byte lines in aligned
+/// pairs, so only 128 keeps the sides fully apart there.
+template<std::size_t LineSize>
+struct PaddedLayout
+{
+    static constexpr std::size_t lineSize = LineSize;
+    static constexpr bool separateCachedCursors = true;
+};
+
+/// The default layout
+using Padded64Layout = PaddedLayout<64>;
+
+using Padded128Layout = PaddedLayout<128>;
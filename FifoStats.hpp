@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+
+/// Counters kept by one side, push or pop, of a fifo
+struct FifoSideStats
+{
+    /// Number of loads of the other side's cursor into the cached cursor
+    std::uint64_t refreshes;
+    /// Number of pushes that found the fifo full, or pops that found it
+    /// empty
+    std::uint64_t failures;
+    /// Highest occupancy seen just after a refresh
+    std::uint64_t highWater;
+};
+
+struct FifoStatsSnapshot
+{
+    FifoSideStats push;
+    FifoSideStats pop;
+};
+
+
+/// The default statistics policy for Fifo4 and Fifo5. Keeps nothing; every
+/// call compiles away.
+struct NoStats
+{
+    static constexpr bool enabled = false;
+
+    struct Side
+    {
+        void refresh(std::uint64_t) noexcept {}
+        void fail() noexcept {}
+    };
+};
+
+
+/// Statistics policy that counts cached cursor refreshes, failed pushes or
+/// pops and the occupancy high-water mark. Each side's counters live in
+/// that side's thread-exclusive cache line and are written only by that
+/// thread, so updates are plain relaxed stores; snapshots may be taken from
+/// any thread.
+///
+/// Occupancy is only sampled when the cached cursor is refreshed, which is
+/// when it is exact. Between refreshes the push side overestimates and the
+/// pop side underestimates occupancy, so sampling there would add a cost to
+/// every operation without adding accuracy.
+struct CounterStats
+{
+    static constexpr bool enabled = true;
+
+    class Side
+    {
+    public:
+        void refresh(std::uint64_t occupancy) noexcept {
+            increment(refreshes_);
+            if (occupancy > highWater_.load(std::memory_order_relaxed)) {
+                highWater_.store(occupancy, std::memory_order_relaxed);
+            }
+        }
+
+        void fail() noexcept { increment(failures_); }
+
+        FifoSideStats snapshot() const noexcept {
+            return {
+                refreshes_.load(std::memory_order_relaxed),
+                failures_.load(std::memory_order_relaxed),
+                highWater_.load(std::memory_order_relaxed)};
+        }
+
+    private:
+        static void increment(std::atomic<std::uint64_t>& counter) noexcept {
+            counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        std::atomic<std::uint64_t> refreshes_{};
+        std::atomic<std::uint64_t> failures_{};
+        std::atomic<std::uint64_t> highWater_{};
+    };
+};
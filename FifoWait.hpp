@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "Futex.hpp"
+
+
+/// The default blocking policy for Fifo5 to Fifo5c. Keeps no waiting flags
+/// and provides no pushWait() or popWait(), so publishing a cursor is a
+/// single store.
+struct NoWait
+{
+    static constexpr bool enabled = false;
+
+    template<std::size_t LineSize>
+    struct Flags {};
+};
+
+
+/// Blocking policy that adds pushWait() and popWait(), which park the
+/// thread with futex(2); see Futex.hpp. Every publish then also checks
+/// whether the other thread is parked.
+struct FutexWait
+{
+    static constexpr bool enabled = true;
+
+    /// Set by a thread parked in pushWait() or popWait() respectively and
+    /// loaded by the other thread after each publish, each on its own line
+    template<std::size_t LineSize>
+    struct Flags
+    {
+        alignas(LineSize) std::atomic<std::uint32_t> pushWaiting{};
+        alignas(LineSize) std::atomic<std::uint32_t> popWaiting{};
+    };
+};
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+
+#include <linux/futex.h>
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+/// Blocking support for the fifos' pushWait() and popWait().
+///
+/// A thread that must wait spins briefly and then sets a waiting flag and
+/// parks on it with futex(2). The other thread checks the flag after every
+/// cursor publish and wakes the waiter only if it is set. Storing the cursor
+/// and then loading the flag needs a StoreLoad barrier, as does setting the
+/// flag and then re-checking the cursor. To keep a full fence off the
+/// publishing thread's hot path the barrier is made asymmetric with
+/// membarrier(2): the rare parking thread pays for a process-wide barrier
+/// and the publishing thread needs only a compiler barrier.
+namespace futex {
+
+/// Number of attempts before a waiting thread parks
+constexpr auto spinsBeforePark = 1024;
+
+inline bool registerMembarrier() noexcept {
+    auto query = ::syscall(SYS_membarrier, MEMBARRIER_CMD_QUERY, 0, 0);
+    return query != -1
+        && (query & MEMBARRIER_CMD_PRIVATE_EXPEDITED) != 0
+        && ::syscall(SYS_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0) == 0;
+}
+
+/// Whether membarrier(2) is usable; if not both sides use a full fence.
+/// Registers on first use so that merely including this header costs
+/// nothing.
+inline bool membarrierAvailable() noexcept {
+    static bool const available = registerMembarrier();
+    return available;
+}
+
+inline void fullFence() noexcept {
+#if defined(__SANITIZE_THREAD__)
+    // atomic_thread_fence is not supported with -fsanitize=thread; a seq_cst
+    // read-modify-write is a full barrier on x86
+    static std::atomic<int> word;
+    word.fetch_add(0, std::memory_order_seq_cst);
+#else
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+#endif
+}
+
+/// The publishing thread's half of the asymmetric fence
+inline void lightFence() noexcept {
+    if (membarrierAvailable()) [[likely]] {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+    } else {
+        fullFence();
+    }
+}
+
+/// The parking thread's half of the asymmetric fence
+inline void heavyFence() noexcept {
+    if (membarrierAvailable()) [[likely]] {
+        ::syscall(SYS_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+    } else {
+        fullFence();
+    }
+}
+
+inline void wait(std::atomic<std::uint32_t>& word, std::uint32_t expected, ::timespec const* timeout) noexcept {
+    static_assert(sizeof(word) == sizeof(std::uint32_t));
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+}
+
+inline void wake(std::atomic<std::uint32_t>& word) noexcept {
+    ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+
+/// Call after publishing a cursor. Wakes the other thread if it is parked
+/// on `waiting` in spinThenPark().
+inline void wakeIfWaiting(std::atomic<std::uint32_t>& waiting) noexcept {
+    lightFence();
+    if (waiting.load(std::memory_order_relaxed) != 0) [[unlikely]] {
+        // Change the futex word before waking so a waiter that has not yet
+        // called wait() does not go to sleep
+        waiting.store(0, std::memory_order_relaxed);
+        wake(waiting);
+    }
+}
+
+/// Calls `tryOp` until it returns `true`, spinning for a while and then
+/// parking on `waiting` between attempts.
+/// @param deadline if not null, give up once this time has passed
+/// @return `true` if `tryOp` succeeded; `false` if the deadline passed
+template<typename TryOp>
+bool spinThenPark(TryOp&& tryOp, std::atomic<std::uint32_t>& waiting,
+                  std::chrono::steady_clock::time_point const* deadline = nullptr) {
+    for (auto spin = 0; spin < spinsBeforePark; ++spin) {
+        if (tryOp()) {
+            return true;
+        }
+    }
+
+    while (true) {
+        waiting.store(1, std::memory_order_relaxed);
+        heavyFence();
+        if (tryOp()) {
+            waiting.store(0, std::memory_order_relaxed);
+            return true;
+        }
+
+        if (deadline) {
+            auto remaining = *deadline - std::chrono::steady_clock::now();
+            if (remaining <= remaining.zero()) {
+                waiting.store(0, std::memory_order_relaxed);
+                return false;
+            }
+            auto seconds = std::chrono::duration_cast<std::chrono::seconds>(remaining);
+            auto timeout = ::timespec{
+                static_cast<std::time_t>(seconds.count()),
+                static_cast<long>(std::chrono::nanoseconds(remaining - seconds).count())};
+            wait(waiting, 1, &timeout);
+        } else {
+            wait(waiting, 1, nullptr);
+        }
+    }
+}
+
+}  // namespace futex
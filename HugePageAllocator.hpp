@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+
+/// Allocator for large rings that backs each allocation with huge pages so
+/// the ring needs one TLB entry per 2 MiB or 1 GiB rather than per 4 KiB.
+///
+/// An allocation is rounded up to a multiple of 2 MiB and mapped with the
+/// first of these that succeeds:
+///   - explicit 1 GiB MAP_HUGETLB pages, if the size is a multiple of 1 GiB
+///   - explicit 2 MiB MAP_HUGETLB pages
+///   - 2 MiB aligned anonymous memory advised as MADV_HUGEPAGE, for the
+///     kernel's transparent huge pages
+/// Explicit huge pages must be reserved by the administrator, e.g. via
+/// /proc/sys/vm/nr_hugepages; without them the last is used.
+///
+/// The pages are prefaulted and then mlock()ed, so the first laps around
+/// the ring take no page faults. mlock() is best effort since it is
+/// limited by RLIMIT_MEMLOCK.
+template<typename T>
+class HugePageAllocator
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    HugePageAllocator() noexcept = default;
+    template<typename U>
+    HugePageAllocator(HugePageAllocator<U> const&) noexcept {}
+
+    T* allocate(size_type n) {
+        auto length = mappingLength(n);
+        auto* p = mapHugeTlb(length);
+        if (not p) {
+            p = mapTransparent(length);
+        }
+        if (not p) {
+            throw std::bad_alloc();
+        }
+        prefault(p, length);
+        ::mlock(p, length);
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, size_type n) noexcept {
+        // munmap() also unlocks
+        ::munmap(p, mappingLength(n));
+    }
+
+    friend bool operator==(HugePageAllocator const&, HugePageAllocator const&) noexcept { return true; }
+
+private:
+    static constexpr auto pageSize2M = size_type{1} << 21;
+    static constexpr auto pageSize1G = size_type{1} << 30;
+
+    static auto mappingLength(size_type n) noexcept {
+        return (n * sizeof(T) + pageSize2M - 1) & ~(pageSize2M - 1);
+    }
+
+    static void* mapHugeTlb(size_type length) noexcept {
+        constexpr auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+        if (length % pageSize1G == 0) {
+            auto* p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags | (30 << MAP_HUGE_SHIFT), -1, 0);
+            if (p != MAP_FAILED) {
+                return p;
+            }
+        }
+        auto* p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags | (21 << MAP_HUGE_SHIFT), -1, 0);
+        return p != MAP_FAILED ? p : nullptr;
+    }
+
+    static void* mapTransparent(size_type length) noexcept {
+        // Over-allocate then trim to a 2 MiB boundary so that whole
+        // transparent huge pages fit
+        auto* raw = ::mmap(nullptr, length + pageSize2M, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            return nullptr;
+        }
+        auto* begin = static_cast<std::byte*>(raw);
+        auto head = (pageSize2M - reinterpret_cast<std::uintptr_t>(begin) % pageSize2M) % pageSize2M;
+        if (head != 0) {
+            ::munmap(begin, head);
+        }
+        ::munmap(begin + head + length, pageSize2M - head);
+        auto* p = begin + head;
+        ::madvise(p, length, MADV_HUGEPAGE);
+        return p;
+    }
+
+    /// Touch every page so that it is backed now rather than on first use
+    static void prefault(void* p, size_type length) noexcept {
+        if (::madvise(p, length, MADV_POPULATE_WRITE) == 0) {
+            return;
+        }
+        // Kernels before 5.14
+        auto pageSize = size_type(::sysconf(_SC_PAGESIZE));
+        auto* bytes = static_cast<std::byte volatile*>(p);
+        for (auto offset = size_type{}; offset < length; offset += pageSize) {
+            bytes[offset] = std::byte{};
+        }
+    }
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+
+/// Multi-producer, multi-consumer bounded FIFO after Dmitry Vyukov's
+/// bounded MPMC queue.
+///
+/// Each cell carries a sequence number. The cell at cursor c is free for
+/// the push that claims c when its sequence is c and holds that push's
+/// element when its sequence is c + 1. Pushes and pops claim a cursor by
+/// compare-and-swap on the shared push or pop cursor, then hand the cell on
+/// by storing to its sequence: c + 1 after a push and c + capacity() after
+/// a pop.
+///
+/// @tparam PaddedCells if `true` each cell is given its own cache line so
+/// threads working on adjacent cells do not false share, at the cost of
+/// a larger ring.
+template<typename T, typename Alloc = std::allocator<T>, bool PaddedCells = false>
+    requires std::is_trivial_v<T>
+class MpmcFifo
+{
+    struct Cell;
+
+public:
+    using value_type = T;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Cell>;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit MpmcFifo(size_type capacity, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , mask_{capacity - 1}
+        , ring_{allocator_traits::allocate(alloc_, capacity)} {
+        assert((capacity & mask_) == 0);
+        for (auto cursor = size_type{}; cursor < capacity; ++cursor) {
+            new (&ring_[cursor]) Cell{cursor, T{}};
+        }
+    }
+
+    MpmcFifo(MpmcFifo const&) = delete;
+    MpmcFifo& operator=(MpmcFifo const&) = delete;
+
+    ~MpmcFifo() {
+        allocator_traits::deallocate(alloc_, ring_, capacity());
+    }
+
+
+    /// Returns the number of elements in the fifo, counting claimed but
+    /// unfinished pushes and pops. Exact only when neither is in progress.
+    auto size() const noexcept {
+        // Load the pop cursor first; it may overtake an earlier load of the
+        // push cursor
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+
+    /// Push one object onto the fifo. May be called from any number of
+    /// threads.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = element(pushCursor);
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == pushCursor) {
+                if (pushCursor_.compare_exchange_weak(pushCursor, pushCursor + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pushCursor + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < pushCursor) {
+                // Holds the previous lap's element or its pop is unfinished
+                return false;
+            } else {
+                // Another thread pushed to this cursor
+                pushCursor = pushCursor_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Pop one object from the fifo. May be called from any number of
+    /// threads.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        while (true) {
+            auto& cell = element(popCursor);
+            auto sequence = cell.sequence.load(std::memory_order_acquire);
+            if (sequence == popCursor + 1) {
+                if (popCursor_.compare_exchange_weak(popCursor, popCursor + 1, std::memory_order_relaxed)) {
+                    value = cell.value;
+                    cell.sequence.store(popCursor + capacity(), std::memory_order_release);
+                    return true;
+                }
+            } else if (sequence < popCursor + 1) {
+                // Not yet pushed
+                return false;
+            } else {
+                // Another thread popped this cursor
+                popCursor = popCursor_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    struct alignas(PaddedCells ? hardware_destructive_interference_size : 1) alignas(std::atomic<size_type>) alignas(T) Cell
+    {
+        std::atomic<size_type> sequence;
+        T value;
+    };
+
+    auto& element(size_type cursor) noexcept { return ring_[cursor & mask_]; }
+
+private:
+    [[no_unique_address]] allocator_type alloc_;
+    size_type mask_;
+    Cell* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    /// Loaded and compare-and-swapped by the push threads
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Loaded and compare-and-swapped by the pop threads
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+};
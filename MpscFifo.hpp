@@ -0,0 +1,317 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// Multi-producer, single-consumer bounded FIFO with Fifo5's pusher and
+/// popper API.
+///
+/// Each slot carries a sequence number. A slot at cursor c is free for the
+/// push that claims c when its sequence is c and is full when its sequence
+/// is c + 1. Producers claim a cursor by compare-and-swap on the shared
+/// push cursor and publish by storing c + 1 to the slot's sequence, so the
+/// consumer reads only the slot it is about to pop, never the push cursor.
+/// Popping stores c + capacity() to the sequence, freeing the slot for the
+/// next lap.
+///
+/// A claimed slot cannot be given back once later slots may have been
+/// claimed, so releasing a pusher_t publishes its slot marked as skipped
+/// and the consumer steps over it.
+template<typename T, typename Alloc = std::allocator<T>>
+    requires std::is_trivial_v<T>
+class MpscFifo
+{
+    struct Slot;
+
+public:
+    using value_type = T;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit MpscFifo(size_type capacity, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , mask_{capacity - 1}
+        , ring_{allocator_traits::allocate(alloc_, capacity)} {
+        assert((capacity & mask_) == 0);
+        for (auto cursor = size_type{}; cursor < capacity; ++cursor) {
+            new (&ring_[cursor]) Slot{cursor, false, T{}};
+        }
+    }
+
+    MpscFifo(MpscFifo const&) = delete;
+    MpscFifo& operator=(MpscFifo const&) = delete;
+
+    ~MpscFifo() {
+        allocator_traits::deallocate(alloc_, ring_, capacity());
+    }
+
+
+    /// Returns the number of elements in the fifo, counting claimed but
+    /// unpublished slots. Exact only when no push is in progress.
+    auto size() const noexcept {
+        // Load the pop cursor first; it may overtake an earlier load of the
+        // push cursor
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(MpscFifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::exchange(other.fifo_, nullptr)}
+            , cursor_{other.cursor_} {
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            if (fifo_) {
+                fifo_->publishPush(cursor_, false);
+            }
+            fifo_ = std::exchange(other.fifo_, nullptr);
+            cursor_ = other.cursor_;
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                fifo_->publishPush(cursor_, false);
+            }
+        }
+
+        /// If called the pushed slot is marked as skipped and the pop
+        /// thread will pass over it. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept {
+            if (fifo_) {
+                fifo_->publishPush(cursor_, true);
+            }
+            fifo_ = {};
+        }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return &fifo_->slot(cursor_).value; }
+        value_type const* get() const noexcept { return &fifo_->slot(cursor_).value; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        MpscFifo* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher. May be called
+    /// from any number of threads.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        while (true) {
+            auto sequence = slot(pushCursor).sequence.load(std::memory_order_acquire);
+            if (sequence == pushCursor) {
+                if (pushCursor_.compare_exchange_weak(pushCursor, pushCursor + 1, std::memory_order_relaxed)) {
+                    return pusher_t(this, pushCursor);
+                }
+            } else if (sequence < pushCursor) {
+                // Still holds the element from the previous lap
+                return pusher_t{};
+            } else {
+                // Another producer claimed this cursor
+                pushCursor = pushCursor_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// Push one object onto the fifo. May be called from any number of
+    /// threads.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's ring. The
+    /// actual pop happens when the popper goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(MpscFifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                fifo_->publishPop(cursor_);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return &fifo_->slot(cursor_).value; }
+        value_type const* get() const noexcept { return &fifo_->slot(cursor_).value; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        MpscFifo* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    /// Optionally pop one object via a popper. Only one thread may pop.
+    auto pop() noexcept {
+        auto popCursor = skipReleased(popCursor_.load(std::memory_order_relaxed));
+        if (ready(popCursor)) {
+            return popper_t(this, popCursor);
+        }
+        return popper_t{};
+    };
+
+    /// Pop one object from the fifo. Only one thread may pop.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_type> sequence;
+        bool skip;
+        T value;
+    };
+
+    void publishPush(size_type pushCursor, bool skip) noexcept {
+        auto& s = slot(pushCursor);
+        s.skip = skip;
+        s.sequence.store(pushCursor + 1, std::memory_order_release);
+    }
+
+    void publishPop(size_type popCursor) noexcept {
+        slot(popCursor).sequence.store(popCursor + capacity(), std::memory_order_release);
+        popCursor_.store(skipReleased(popCursor + 1), std::memory_order_relaxed);
+    }
+
+    auto ready(size_type popCursor) const noexcept {
+        return slot(popCursor).sequence.load(std::memory_order_acquire) == popCursor + 1;
+    }
+
+    /// Pop any published skipped slots starting at `popCursor`. Called
+    /// after each pop as well as before, so size() stays exact when the
+    /// last push was released.
+    /// @return the cursor of the first slot that is not a published skip
+    size_type skipReleased(size_type popCursor) noexcept {
+        if (ready(popCursor) && slot(popCursor).skip) [[unlikely]] {
+            do {
+                slot(popCursor).sequence.store(popCursor + capacity(), std::memory_order_release);
+                ++popCursor;
+            } while (ready(popCursor) && slot(popCursor).skip);
+            popCursor_.store(popCursor, std::memory_order_relaxed);
+        }
+        return popCursor;
+    }
+
+    auto& slot(size_type cursor) noexcept { return ring_[cursor & mask_]; }
+    auto const& slot(size_type cursor) const noexcept { return ring_[cursor & mask_]; }
+
+private:
+    [[no_unique_address]] allocator_type alloc_;
+    size_type mask_;
+    Slot* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and compare-and-swapped by the push threads
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Stored by the pop thread; loaded by size()
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+};
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <new>
+#include <system_error>
+
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+/// Page granular memory bound to a NUMA node. Uses the mbind system call
+/// directly so there is no dependency on libnuma.
+namespace numa {
+
+/// Highest node number that may be bound to
+constexpr auto maxNodes = 1024;
+
+inline std::size_t pageRound(std::size_t bytes) noexcept {
+    auto pageSize = std::size_t(::sysconf(_SC_PAGESIZE));
+    return (bytes + pageSize - 1) / pageSize * pageSize;
+}
+
+/// Allocate `bytes` bound to `node` and prefault them, so they are placed
+/// now rather than by whichever thread first touches them. A `node` of -1
+/// leaves placement to the kernel's default policy, normally the node of
+/// the calling thread.
+inline void* allocate(std::size_t bytes, int node) {
+    auto length = pageRound(bytes);
+    auto* p = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    if (node >= 0) {
+        constexpr auto bitsPerWord = sizeof(unsigned long) * CHAR_BIT;
+        unsigned long mask[maxNodes / bitsPerWord] = {};
+        if (node >= maxNodes) {
+            ::munmap(p, length);
+            throw std::system_error(EINVAL, std::generic_category(), "mbind");
+        }
+        mask[std::size_t(node) / bitsPerWord] = 1ul << (std::size_t(node) % bitsPerWord);
+        if (::syscall(SYS_mbind, p, length, MPOL_BIND, mask, maxNodes + 1, 0) == -1) {
+            auto error = errno;
+            ::munmap(p, length);
+            throw std::system_error(error, std::generic_category(), "mbind");
+        }
+    }
+
+    if (::madvise(p, length, MADV_POPULATE_WRITE) == -1) {
+        // Kernels before 5.14
+        auto pageSize = std::size_t(::sysconf(_SC_PAGESIZE));
+        auto* bytes = static_cast<std::byte volatile*>(p);
+        for (auto offset = std::size_t{}; offset < length; offset += pageSize) {
+            bytes[offset] = std::byte{};
+        }
+    }
+    return p;
+}
+
+inline void deallocate(void* p, std::size_t bytes) noexcept {
+    ::munmap(p, pageRound(bytes));
+}
+
+}  // namespace numa
+
+
+/// Allocator that places a fifo's ring on one NUMA node, e.g. the
+/// consumer's, regardless of which thread constructs the fifo. A default
+/// constructed NumaAllocator binds nothing and so places the ring on the
+/// constructing thread's node.
+///
+/// The cursors live in the fifo object itself, not in the ring, so they
+/// are placed by whatever allocates the fifo; numa::allocate() can place
+/// that too. A page is the unit of placement so the push and pop cursor
+/// lines of one fifo are always on the same node.
+template<typename T>
+class NumaAllocator
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    explicit NumaAllocator(int node = -1) noexcept : node_{node} {}
+    template<typename U>
+    NumaAllocator(NumaAllocator<U> const& other) noexcept : node_{other.node()} {}
+
+    /// Returns the node allocations are bound to; -1 for none
+    int node() const noexcept { return node_; }
+
+    T* allocate(size_type n) {
+        return static_cast<T*>(numa::allocate(n * sizeof(T), node_));
+    }
+
+    void deallocate(T* p, size_type n) noexcept {
+        numa::deallocate(p, n * sizeof(T));
+    }
+
+    friend bool operator==(NumaAllocator const&, NumaAllocator const&) noexcept = default;
+
+private:
+    int node_;
+};
@@ -0,0 +1,412 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// Fifo5a for a push thread and a pop thread in different processes. The
+/// cursors, cached cursors and ring all live in one shared memory mapping
+/// that holds no pointers, so each process may map it at any address.
+///
+/// A ShmFifo is a process-local handle that owns one mapping. create()
+/// makes a new POSIX shared memory object and createAnonymous() a memfd to
+/// be inherited across fork() or passed over a Unix socket; attach() maps
+/// an existing one.
+template<typename T>
+    requires std::is_trivial_v<T>
+class ShmFifo
+{
+public:
+    using value_type = T;
+    using size_type = std::size_t;
+
+    /// Create a fifo in the new POSIX shared memory object `name`, which
+    /// must not already exist. The caller is responsible for unlink().
+    static ShmFifo create(char const* name, size_type capacity) {
+        auto fd = ::shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+        check(fd != -1, "shm_open");
+        return ShmFifo(fd, capacity);
+    }
+
+    /// Create a fifo in an anonymous memfd. The mapping is shared with
+    /// child processes across fork(), and fd() can be passed to attach().
+    static ShmFifo createAnonymous(size_type capacity) {
+        auto fd = ::memfd_create("ShmFifo", MFD_CLOEXEC);
+        check(fd != -1, "memfd_create");
+        return ShmFifo(fd, capacity);
+    }
+
+    /// Attach to the fifo in POSIX shared memory object `name`
+    static ShmFifo attach(char const* name) {
+        auto fd = ::shm_open(name, O_RDWR, 0);
+        check(fd != -1, "shm_open");
+        return ShmFifo(fd);
+    }
+
+    /// Attach to the fifo in shared memory file descriptor `fd`, which is
+    /// duplicated
+    static ShmFifo attach(int fd) {
+        auto dup = ::dup(fd);
+        check(dup != -1, "dup");
+        return ShmFifo(dup);
+    }
+
+    /// Remove the POSIX shared memory object `name`. Processes that have
+    /// attached keep their mappings.
+    static void unlink(char const* name) {
+        check(::shm_unlink(name) != -1, "shm_unlink");
+    }
+
+    ShmFifo(ShmFifo const&) = delete;
+    ShmFifo& operator=(ShmFifo const&) = delete;
+
+    ShmFifo(ShmFifo&& other) noexcept
+        : fd_{std::exchange(other.fd_, -1)}
+        , header_{std::exchange(other.header_, nullptr)}
+        , ring_{std::exchange(other.ring_, nullptr)}
+        , mask_{other.mask_}
+        , mapped_{other.mapped_} {
+    }
+    ShmFifo& operator=(ShmFifo&& other) noexcept {
+        if (this != &other) {
+            close();
+            fd_ = std::exchange(other.fd_, -1);
+            header_ = std::exchange(other.header_, nullptr);
+            ring_ = std::exchange(other.ring_, nullptr);
+            mask_ = other.mask_;
+            mapped_ = other.mapped_;
+        }
+        return *this;
+    }
+
+    ~ShmFifo() {
+        close();
+    }
+
+    /// Returns the shared memory file descriptor
+    int fd() const noexcept { return fd_; }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = header_->pushCursor.load(std::memory_order_relaxed);
+        auto popCursor = header_->popCursor.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(ShmFifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                fifo_->header_->pushCursor.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        ShmFifo* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = header_->pushCursor.load(std::memory_order_relaxed);
+        if (full(pushCursor, header_->popCursorCached)) {
+            header_->popCursorCached = header_->popCursor.load(std::memory_order_acquire);
+            if (full(pushCursor, header_->popCursorCached)) {
+                return pusher_t{};
+            }
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Push one object onto the fifo.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's ring. The
+    /// actual pop happens when the popper goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(ShmFifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                fifo_->header_->popCursor.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return fifo_->element(cursor_); }
+        value_type const* get() const noexcept { return fifo_->element(cursor_); }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        ShmFifo* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    auto pop() noexcept {
+        auto popCursor = header_->popCursor.load(std::memory_order_relaxed);
+        if (empty(header_->pushCursorCached, popCursor)) {
+            header_->pushCursorCached = header_->pushCursor.load(std::memory_order_acquire);
+            if (empty(header_->pushCursorCached, popCursor)) {
+                return popper_t{};
+            }
+        }
+        return popper_t(this, popCursor);
+    };
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free, "must be address-free to be shared between processes");
+
+    /// Written once when created. Identifies the mapping as a ShmFifo of T.
+    static constexpr auto magic = std::uint64_t{0x5368'6d46'6966'6f31};  // "ShmFifo1"
+
+    /// The start of the mapping; the ring follows
+    struct Header
+    {
+        std::atomic<std::uint64_t> magic;
+        size_type elementSize;
+        size_type mask;
+
+        /// Loaded and stored by the push thread; loaded by the pop thread
+        alignas(hardware_destructive_interference_size) CursorType pushCursor;
+
+        /// Exclusive to the push thread
+        alignas(hardware_destructive_interference_size) size_type popCursorCached;
+
+        /// Loaded and stored by the pop thread; loaded by the push thread
+        alignas(hardware_destructive_interference_size) CursorType popCursor;
+
+        /// Exclusive to the pop thread
+        alignas(hardware_destructive_interference_size) size_type pushCursorCached;
+    };
+
+    static constexpr auto ringOffset =
+        (sizeof(Header) + hardware_destructive_interference_size - 1)
+        / hardware_destructive_interference_size * hardware_destructive_interference_size;
+
+    static void check(bool ok, char const* what) {
+        if (not ok) {
+            throw std::system_error(errno, std::generic_category(), what);
+        }
+    }
+
+    /// Release what has been acquired so far and throw. For use in the
+    /// constructors, where the destructor will not run.
+    [[noreturn]] void fail(int error, char const* what) {
+        close();
+        throw std::system_error(error, std::generic_category(), what);
+    }
+
+    static auto mappingSize(size_type capacity) noexcept { return ringOffset + capacity * sizeof(T); }
+
+    /// Create in the empty shared memory `fd`
+    ShmFifo(int fd, size_type capacity) : fd_{fd} {
+        assert(capacity != 0 && (capacity & (capacity - 1)) == 0);
+        if (::ftruncate(fd_, off_t(mappingSize(capacity))) == -1) {
+            fail(errno, "ftruncate");
+        }
+        map(mappingSize(capacity));
+
+        // ftruncate zero fills so the cursors are already zero
+        mask_ = capacity - 1;
+        header_->elementSize = sizeof(T);
+        header_->mask = mask_;
+        header_->magic.store(magic, std::memory_order_release);
+    }
+
+    /// Attach to the fifo in shared memory `fd`
+    explicit ShmFifo(int fd) : fd_{fd} {
+        struct ::stat st;
+        if (::fstat(fd_, &st) == -1) {
+            fail(errno, "fstat");
+        }
+        if (size_type(st.st_size) < ringOffset) {
+            fail(EINVAL, "ShmFifo attach: too small");
+        }
+        map(size_type(st.st_size));
+
+        if (header_->magic.load(std::memory_order_acquire) != magic
+            || header_->elementSize != sizeof(T)
+            || mappingSize(header_->mask + 1) > size_type(st.st_size)) {
+            fail(EINVAL, "ShmFifo attach: not a matching fifo");
+        }
+        mask_ = header_->mask;
+    }
+
+    void map(size_type size) {
+        auto address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (address == MAP_FAILED) {
+            fail(errno, "mmap");
+        }
+        header_ = static_cast<Header*>(address);
+        ring_ = reinterpret_cast<T*>(static_cast<std::byte*>(address) + ringOffset);
+        mapped_ = size;
+    }
+
+    void close() noexcept {
+        if (header_) {
+            ::munmap(header_, mapped_);
+            header_ = nullptr;
+            ring_ = nullptr;
+        }
+        if (fd_ != -1) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    auto full(size_type pushCursor, size_type popCursor) const noexcept {
+        assert(popCursor <= pushCursor);
+        return (pushCursor - popCursor) == capacity();
+    }
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    auto* element(size_type cursor) noexcept { return &ring_[cursor & mask_]; }
+    auto const* element(size_type cursor) const noexcept { return &ring_[cursor & mask_]; }
+
+private:
+    int fd_{-1};
+    Header* header_{};
+    T* ring_{};
+    size_type mask_{};
+    size_type mapped_{};
+};
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// Single-producer, multi-consumer bounded FIFO that hands each element to
+/// exactly one consumer, with Fifo5's pusher and popper API.
+///
+/// Each slot carries a sequence number. The slot at cursor c is free for
+/// the push at c when its sequence is c and holds that push's element when
+/// its sequence is c + 1. The push thread is alone so it publishes with a
+/// plain store, first checking that the slot's sequence shows it free.
+/// Pop threads claim a cursor by compare-and-swap on the shared pop cursor
+/// and free the slot by storing c + capacity() to its sequence once they
+/// are done with it, which may be out of order.
+///
+/// Once claimed a pop cannot be given back, since other pop threads may
+/// have claimed later cursors, so unlike Fifo5's popper_t this one has no
+/// release().
+template<typename T, typename Alloc = std::allocator<T>>
+    requires std::is_trivial_v<T>
+class SpmcFifo
+{
+    struct Slot;
+
+public:
+    using value_type = T;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Slot>;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+    using size_type = typename allocator_traits::size_type;
+
+    explicit SpmcFifo(size_type capacity, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , mask_{capacity - 1}
+        , ring_{allocator_traits::allocate(alloc_, capacity)} {
+        assert((capacity & mask_) == 0);
+        for (auto cursor = size_type{}; cursor < capacity; ++cursor) {
+            new (&ring_[cursor]) Slot{cursor, T{}};
+        }
+    }
+
+    SpmcFifo(SpmcFifo const&) = delete;
+    SpmcFifo& operator=(SpmcFifo const&) = delete;
+
+    ~SpmcFifo() {
+        allocator_traits::deallocate(alloc_, ring_, capacity());
+    }
+
+
+    /// Returns the number of unclaimed elements in the fifo
+    auto size() const noexcept {
+        // Load the pop cursor first; it may overtake an earlier load of the
+        // push cursor
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+
+        // A thread other than the push thread and the pop thread that
+        // claimed the slot may still see the pop cursor ahead
+        return std::max(pushCursor, popCursor) - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns whether the container has capacity_() elements
+    auto full() const noexcept { return size() == capacity(); }
+
+    /// Returns the number of elements that can be held in the fifo
+    auto capacity() const noexcept { return mask_ + 1; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's ring. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(SpmcFifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                // Store the push cursor first so that a pop thread that
+                // claims this slot sees the push cursor past it
+                fifo_->pushCursor_.store(cursor_ + 1, std::memory_order_relaxed);
+                fifo_->slot(cursor_).sequence.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return &fifo_->slot(cursor_).value; }
+        value_type const* get() const noexcept { return &fifo_->slot(cursor_).value; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        SpmcFifo* fifo_{};
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Optionally push one object onto a file via a pusher. Only one
+    /// thread may push.
+    /// @return a pointer to pusher_t.
+    pusher_t push() noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (slot(pushCursor).sequence.load(std::memory_order_acquire) != pushCursor) {
+            // The previous lap's element is unclaimed or still being popped
+            return pusher_t{};
+        }
+        return pusher_t(this, pushCursor);
+    }
+
+    /// Push one object onto the fifo. Only one thread may push.
+    /// @return `true` if the operation is successful; `false` if fifo is full.
+    auto push(T const& value) noexcept {
+        if (auto pusher = push(); pusher) {
+            pusher = value;
+            return true;
+        }
+        return false;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's ring. The slot
+    /// is freed for the push thread when the popper goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(SpmcFifo* fifo, size_type cursor) noexcept : fifo_{fifo}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::exchange(other.fifo_, nullptr)}
+            , cursor_{other.cursor_} {
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            if (fifo_) {
+                fifo_->publishPop(cursor_);
+            }
+            fifo_ = std::exchange(other.fifo_, nullptr);
+            cursor_ = other.cursor_;
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                fifo_->publishPop(cursor_);
+            }
+        }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's ring
+        ///@{
+        value_type* get() noexcept { return &fifo_->slot(cursor_).value; }
+        value_type const* get() const noexcept { return &fifo_->slot(cursor_).value; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        SpmcFifo* fifo_{};
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    /// Optionally claim one object via a popper. May be called from any
+    /// number of threads.
+    auto pop() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        while (true) {
+            auto sequence = slot(popCursor).sequence.load(std::memory_order_acquire);
+            if (sequence == popCursor + 1) {
+                if (popCursor_.compare_exchange_weak(popCursor, popCursor + 1, std::memory_order_relaxed)) {
+                    return popper_t(this, popCursor);
+                }
+            } else if (sequence < popCursor + 1) {
+                // Not yet pushed
+                return popper_t{};
+            } else {
+                // Another thread popped this cursor
+                popCursor = popCursor_.load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    /// Pop one object from the fifo. May be called from any number of
+    /// threads.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_type> sequence;
+        T value;
+    };
+
+    void publishPop(size_type popCursor) noexcept {
+        slot(popCursor).sequence.store(popCursor + capacity(), std::memory_order_release);
+    }
+
+    auto& slot(size_type cursor) noexcept { return ring_[cursor & mask_]; }
+    auto const& slot(size_type cursor) const noexcept { return ring_[cursor & mask_]; }
+
+private:
+    [[no_unique_address]] allocator_type alloc_;
+    size_type mask_;
+    Slot* ring_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = size_type{64};
+
+    /// Loaded and stored by the push thread; loaded by size()
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Loaded and compare-and-swapped by the pop threads
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(size_type)];
+};
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+
+
+/// Unbounded SPSC fifo made of a chain of fixed size blocks, with Fifo5a's
+/// pusher and popper API. push() never fails; it takes a new block when
+/// the current one is used up instead.
+///
+/// The push and pop cursors count elements as in Fifo5a. Each block holds
+/// blockCapacity() consecutive cursors, so unlike Fifo5a's ring a block is
+/// filled and drained only once. The push thread links a new block onto
+/// the chain before publishing a cursor in it, and the pop thread moves on
+/// to the next block when it reaches the end of one and hands the drained
+/// block back through a lock-free free list. Once a burst has been drained
+/// blocks circulate with no further allocation.
+///
+/// On the fast path push() and pop() are Fifo5a's, with the full check
+/// replaced by a check for the end of the block.
+template<typename T, typename Alloc = std::allocator<T>>
+    requires std::is_trivial_v<T>
+class UnboundedFifo
+{
+    // See Fifo3.hpp for reason why std::hardware_destructive_interference_size is not used directly
+    static constexpr auto hardware_destructive_interference_size = std::size_t{64};
+
+    /// A block's header line; the block's elements follow it
+    struct alignas(hardware_destructive_interference_size) Block
+    {
+        /// Next block in the chain or, once drained, in the free list
+        Block* next;
+    };
+
+public:
+    using value_type = T;
+    using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<Block>;
+    using allocator_traits = std::allocator_traits<allocator_type>;
+    using size_type = typename allocator_traits::size_type;
+
+    /// @param blockCapacity the number of elements per block; a power of two
+    explicit UnboundedFifo(size_type blockCapacity, Alloc const& alloc = Alloc{})
+        : alloc_{alloc}
+        , mask_{blockCapacity - 1}
+        , blockLines_{1 + (blockCapacity * sizeof(T) + sizeof(Block) - 1) / sizeof(Block)} {
+        assert((blockCapacity & mask_) == 0);
+        tail_ = head_ = allocateBlock();
+    }
+
+    UnboundedFifo(UnboundedFifo const&) = delete;
+    UnboundedFifo& operator=(UnboundedFifo const&) = delete;
+
+    ~UnboundedFifo() {
+        for (auto* list : {head_, spare_, freeList_.load(std::memory_order_relaxed)}) {
+            while (list) {
+                allocator_traits::deallocate(alloc_, std::exchange(list, list->next), blockLines_);
+            }
+        }
+    }
+
+
+    /// Returns the number of elements in the fifo
+    auto size() const noexcept {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+
+        assert(popCursor <= pushCursor);
+        return pushCursor - popCursor;
+    }
+
+    /// Returns whether the container has no elements
+    auto empty() const noexcept { return size() == 0; }
+
+    /// Returns the number of elements in each block
+    auto blockCapacity() const noexcept { return mask_ + 1; }
+
+    /// Returns the number of blocks allocated so far. Only the push thread
+    /// may call this.
+    auto allocatedBlocks() const noexcept { return allocatedBlocks_; }
+
+
+    /// An RAII proxy object returned by push(). Allows the caller to
+    /// manipulate value_type's members directly in the fifo's block. The
+    /// actual push happens when the pusher goes out of scope.
+    class pusher_t
+    {
+    public:
+        pusher_t() = default;
+        explicit pusher_t(UnboundedFifo* fifo, value_type* element, size_type cursor) noexcept
+            : fifo_{fifo}, element_{element}, cursor_{cursor} {}
+
+        pusher_t(pusher_t const&) = delete;
+        pusher_t& operator=(pusher_t const&) = delete;
+
+        pusher_t(pusher_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , element_{std::move(other.element_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        pusher_t& operator=(pusher_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            element_ = std::move(other.element_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~pusher_t() {
+            if (fifo_) {
+                fifo_->pushCursor_.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual push operation will not be called when the
+        /// pusher_t goes out of scope. Operations on the pusher_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the pusher_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's block
+        ///@{
+        value_type* get() noexcept { return element_; }
+        value_type const* get() const noexcept { return element_; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+        /// Copy-assign a `value_type` to the pusher. Prefer to use this
+        /// form rather than assigning directly to a value_type&. It takes
+        /// advantage of ValueSizeTraits.
+        pusher_t& operator=(value_type const& value) noexcept {
+            std::memcpy(get(), std::addressof(value), ValueSizeTraits<value_type>::size(value));
+            return *this;
+        }
+
+    private:
+        UnboundedFifo* fifo_{};
+        value_type* element_;
+        size_type cursor_;
+    };
+    friend class pusher_t;
+
+    /// Push one object onto the fifo via a pusher, taking a new block if
+    /// the current one is used up.
+    /// @return an active pusher_t.
+    /// @throws whatever the allocator throws if a new block is needed and
+    /// none has been recycled.
+    pusher_t push() {
+        auto pushCursor = pushCursor_.load(std::memory_order_relaxed);
+        if (pushCursor - tailBegin_ == blockCapacity()) {
+            appendBlock();
+        }
+        return pusher_t(this, element(tail_, pushCursor), pushCursor);
+    }
+
+    /// Push one object onto the fifo.
+    /// @return `true`; the fifo is never full.
+    /// @throws whatever the allocator throws if a new block is needed and
+    /// none has been recycled.
+    auto push(T const& value) {
+        auto pusher = push();
+        pusher = value;
+        return true;
+    }
+
+    /// An RAII proxy object returned by pop(). Allows the caller to
+    /// manipulate value_type members directly in the fifo's block. The
+    /// actual pop happens when the popper goes out of scope.
+    class popper_t
+    {
+    public:
+        popper_t() = default;
+        explicit popper_t(UnboundedFifo* fifo, value_type* element, size_type cursor) noexcept
+            : fifo_{fifo}, element_{element}, cursor_{cursor} {}
+
+        popper_t(popper_t const&) = delete;
+        popper_t& operator=(popper_t const&) = delete;
+
+        popper_t(popper_t&& other) noexcept
+            : fifo_{std::move(other.fifo_)}
+            , element_{std::move(other.element_)}
+            , cursor_{std::move(other.cursor_)} {
+            other.release();
+        }
+        popper_t& operator=(popper_t&& other) noexcept {
+            fifo_ = std::move(other.fifo_);
+            element_ = std::move(other.element_);
+            cursor_ = std::move(other.cursor_);
+            other.release();
+            return *this;
+        }
+
+        ~popper_t() {
+            if (fifo_) {
+                fifo_->popCursor_.store(cursor_ + 1, std::memory_order_release);
+            }
+        }
+
+        /// If called the actual pop operation will not be called when the
+        /// popper_t goes out of scope. Operations on the popper_t instance
+        /// after release has been called are undefined.
+        void release() noexcept { fifo_ = {}; }
+
+        /// Return whether or not the popper_t is active.
+        explicit operator bool() const noexcept { return fifo_; }
+
+        /// @name Direct access to the fifo's block
+        ///@{
+        value_type* get() noexcept { return element_; }
+        value_type const* get() const noexcept { return element_; }
+
+        value_type& operator*() noexcept { return *get(); }
+        value_type const& operator*() const noexcept { return *get(); }
+
+        value_type* operator->() noexcept { return get(); }
+        value_type const* operator->() const noexcept { return get(); }
+        ///@}
+
+    private:
+        UnboundedFifo* fifo_{};
+        value_type* element_;
+        size_type cursor_;
+    };
+    friend popper_t;
+
+    /// Optionally pop one object via a popper, moving on to the next block
+    /// and recycling the drained one at the end of a block.
+    auto pop() noexcept {
+        auto popCursor = popCursor_.load(std::memory_order_relaxed);
+        if (empty(pushCursorCached_, popCursor)) {
+            pushCursorCached_ = pushCursor_.load(std::memory_order_acquire);
+            if (empty(pushCursorCached_, popCursor)) {
+                return popper_t{};
+            }
+        }
+        if (popCursor - headBegin_ == blockCapacity()) {
+            // The push thread linked the next block before publishing a
+            // cursor in it
+            recycleBlock(std::exchange(head_, head_->next));
+            headBegin_ = popCursor;
+        }
+        return popper_t(this, element(head_, popCursor), popCursor);
+    };
+
+    /// Pop one object from the fifo.
+    /// @return `true` if the pop operation is successful; `false` if fifo is empty.
+    auto pop(T& value) noexcept {
+        if (auto popper = pop(); popper) {
+            value = *popper;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    static auto empty(size_type pushCursor, size_type popCursor) noexcept {
+        return pushCursor == popCursor;
+    }
+
+    auto* element(Block* block, size_type cursor) noexcept {
+        return reinterpret_cast<T*>(block + 1) + (cursor & mask_);
+    }
+
+    Block* allocateBlock() {
+        auto* block = allocator_traits::allocate(alloc_, blockLines_);
+        ++allocatedBlocks_;
+        return new (block) Block{nullptr};
+    }
+
+    /// Called by the push thread at the end of a block. Prefers a recycled
+    /// block to a new one.
+    void appendBlock() {
+        if (not spare_) {
+            // Take the whole free list so the push thread touches its
+            // cache line once per batch of recycled blocks
+            spare_ = freeList_.exchange(nullptr, std::memory_order_acquire);
+        }
+        auto* block = spare_;
+        if (block) {
+            spare_ = block->next;
+            block->next = nullptr;
+        } else {
+            block = allocateBlock();
+        }
+        tail_->next = block;
+        tail_ = block;
+        tailBegin_ += blockCapacity();
+    }
+
+    /// Called by the pop thread once it has drained `block`
+    void recycleBlock(Block* block) noexcept {
+        block->next = freeList_.load(std::memory_order_relaxed);
+        while (not freeList_.compare_exchange_weak(block->next, block,
+            std::memory_order_release, std::memory_order_relaxed)) {
+            ;
+        }
+    }
+
+private:
+    [[no_unique_address]] allocator_type alloc_;
+    size_type mask_;
+    size_type blockLines_;
+
+    using CursorType = std::atomic<size_type>;
+    static_assert(CursorType::is_always_lock_free);
+
+    /// Loaded and stored by the push thread; loaded by the pop thread
+    alignas(hardware_destructive_interference_size) CursorType pushCursor_{};
+
+    /// Exclusive to the push thread
+    alignas(hardware_destructive_interference_size) Block* tail_{};
+    size_type tailBegin_{};     ///< push cursor at the start of tail_
+    Block* spare_{};            ///< blocks taken from freeList_
+    size_type allocatedBlocks_{};
+
+    /// Loaded and stored by the pop thread; loaded by the push thread
+    alignas(hardware_destructive_interference_size) CursorType popCursor_{};
+
+    /// Exclusive to the pop thread
+    alignas(hardware_destructive_interference_size) Block* head_{};
+    size_type headBegin_{};     ///< pop cursor at the start of head_
+    size_type pushCursorCached_{};
+
+    /// Drained blocks; pushed onto by the pop thread and emptied by the
+    /// push thread
+    alignas(hardware_destructive_interference_size) std::atomic<Block*> freeList_{};
+
+    // Padding to avoid false sharing with adjacent objects
+    char padding_[hardware_destructive_interference_size - sizeof(Block*)];
+};
@@ -1,14 +1,24 @@
+#include "ByteFifo.hpp"
 #include "Fifo4.hpp"
 #include "Fifo4a.hpp"
 #include "Fifo5.hpp"
 #include "Fifo5a.hpp"
 #include "Fifo5b.hpp"
+#include "HugePageAllocator.hpp"
 #include "rigtorp.hpp"
 
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <numeric>
+#include <random>
+#include <span>
 #include <thread>
+#include <vector>
 
 
 static void pinThread(int cpu) {
@@ -85,7 +95,6 @@ void BM_Fifo(benchmark::State& state) {
         }
     }
     state.counters["ops/sec"] = benchmark::Counter(double(value), benchmark::Counter::kIsRate);
-    state.PauseTiming();
     if constexpr(isRigtorp<fifo_type>::value) {
         while(not fifo.try_push(-1)) {}
     } else {
@@ -94,6 +103,338 @@ void BM_Fifo(benchmark::State& state) {
 }
 
 
+/// Pushes batches of state.range(0) elements either one at a time or, if
+/// Bulk, with a single span push so the two can be compared.
+template<template<typename> class FifoT, bool Bulk>
+void BM_FifoBatch(benchmark::State& state) {
+    using fifo_type = FifoT<std::int_fast64_t>;
+    using value_type = typename fifo_type::value_type;
+
+    constexpr auto fifoSize = 131072;
+    fifo_type fifo(fifoSize);
+    auto batchSize = static_cast<std::size_t>(state.range(0));
+
+    auto t = std::jthread([&] {
+        pinThread(cpu1);
+        auto batch = std::vector<value_type>(batchSize);
+        for (auto i = value_type{};;) {
+            auto count = std::size_t{};
+            if constexpr(Bulk) {
+                while ((count = fifo.popUpTo(batch)) == 0) {
+                    ;
+                }
+            } else {
+                while (not fifo.pop(batch[0])) {
+                    ;
+                }
+                count = 1;
+            }
+            for (auto val : std::span(batch).first(count)) {
+                benchmark::DoNotOptimize(val);
+                if (val == -1) {
+                    return;
+                }
+                if (val != i++) {
+                    throw std::runtime_error("invalid value");
+                }
+            }
+        }
+    });
+
+    auto batch = std::vector<value_type>(batchSize);
+    auto value = value_type{};
+    pinThread(cpu2);
+    for (auto _ : state) {
+        std::iota(batch.begin(), batch.end(), value);
+        value += static_cast<value_type>(batchSize);
+        if constexpr(Bulk) {
+            while (auto again = not fifo.push(std::span<value_type const>(batch))) {
+                benchmark::DoNotOptimize(again);
+            }
+        } else {
+            for (auto val : batch) {
+                while (auto again = not fifo.push(val)) {
+                    benchmark::DoNotOptimize(again);
+                }
+            }
+        }
+
+        while (auto again = not fifo.empty()) {
+            benchmark::DoNotOptimize(again);
+        }
+    }
+    state.counters["ops/sec"] = benchmark::Counter(double(value), benchmark::Counter::kIsRate);
+    fifo.push(-1);
+}
+
+
+/// Sweep element of Size bytes
+template<std::size_t Size>
+struct Payload
+{
+    std::int64_t sequence;
+    std::array<char, Size - sizeof(std::int64_t)> data;
+};
+
+/// The sequence alone; a zero-length array would still take a byte
+template<>
+struct Payload<sizeof(std::int64_t)>
+{
+    std::int64_t sequence;
+};
+
+/// Sweep element of Size bytes of which only the first cache line is live
+template<std::size_t Size>
+struct PartialPayload : Payload<Size> {};
+
+// Specialize ValueSizeTraits to copy only the live part of PartialPayload.
+template<std::size_t Size>
+struct ValueSizeTraits<PartialPayload<Size>>
+{
+    using value_type = PartialPayload<Size>;
+    static std::size_t size(value_type const&) { return std::min(Size, std::size_t{64}); }
+};
+
+/// Pop into `value`. Uses the popper, if the fifo has one, so only
+/// ValueSizeTraits::size() bytes are copied out of the ring.
+template<typename FifoT, typename ValueT>
+bool popValue(FifoT& fifo, ValueT& value) {
+    if constexpr(isRigtorp<FifoT>::value) {
+        if (auto front = fifo.front(); front) {
+            value = *front;
+            fifo.pop();
+            return true;
+        }
+        return false;
+    } else if constexpr(requires { fifo.pop().get(); }) {
+        if (auto popper = fifo.pop(); popper) {
+            std::memcpy(&value, popper.get(), ValueSizeTraits<ValueT>::size(*popper));
+            return true;
+        }
+        return false;
+    } else {
+        return fifo.pop(value);
+    }
+}
+
+template<typename FifoT, typename ValueT>
+bool pushValue(FifoT& fifo, ValueT const& value) {
+    if constexpr(isRigtorp<FifoT>::value) {
+        return fifo.try_push(value);
+    } else {
+        return fifo.push(value);
+    }
+}
+
+/// Streams ValueT elements through a fifo of state.range(0) slots. Element
+/// size and capacity together set the ring's footprint relative to the
+/// caches; see sweepCapacities().
+template<template<typename> class FifoT, typename ValueT>
+void BM_Sweep(benchmark::State& state) {
+    using fifo_type = FifoT<ValueT>;
+
+    fifo_type fifo(static_cast<std::size_t>(state.range(0)));
+
+    auto t = std::jthread([&] {
+        pinThread(cpu1);
+        auto val = ValueT{};
+        for (auto i = std::int64_t{};; ++i) {
+            while (not popValue(fifo, val)) {
+                ;
+            }
+            benchmark::DoNotOptimize(val);
+            if (val.sequence == -1) {
+                break;
+            }
+            if (val.sequence != i) {
+                throw std::runtime_error("invalid value");
+            }
+        }
+    });
+
+    auto value = ValueT{};
+    if constexpr(requires { value.data; }) {
+        value.data.fill('a');
+    }
+    pinThread(cpu2);
+    for (auto _ : state) {
+        while (auto again = not pushValue(fifo, value)) {
+            benchmark::DoNotOptimize(again);
+        }
+        ++value.sequence;
+    }
+    state.counters["ops/sec"] = benchmark::Counter(double(value.sequence), benchmark::Counter::kIsRate);
+    state.counters["ring KiB"] = double(state.range(0) * std::int64_t{sizeof(ValueT)}) / 1024;
+    state.SetBytesProcessed(value.sequence * std::int64_t{sizeof(ValueT)});
+
+    value.sequence = -1;
+    while (not pushValue(fifo, value)) {
+        ;
+    }
+}
+
+/// Capacities from 1K to 1M slots; a ring of 8 byte elements starts in L1
+/// and one of 512 byte elements ends well past a typical LLC. Rings over
+/// 64 MiB are skipped.
+template<std::size_t Size>
+void sweepCapacities(benchmark::internal::Benchmark* b) {
+    for (auto capacity = std::int64_t{1024}; capacity <= 1024*1024; capacity *= 4) {
+        if (capacity * std::int64_t{Size} <= 64*1024*1024) {
+            b->Arg(capacity);
+        }
+    }
+}
+
+/// Capacities of 64 byte elements from 4 MiB to 256 MiB rings, which with
+/// 4 KiB pages is from about the reach of a typical second level TLB to
+/// many times beyond it
+static void hugePageCapacities(benchmark::internal::Benchmark* b) {
+    for (auto capacity = std::int64_t{64*1024}; capacity <= 4*1024*1024; capacity *= 4) {
+        b->Arg(capacity);
+    }
+}
+
+template<typename T>
+using Fifo5aHugePages = Fifo5a<T, HugePageAllocator<T>>;
+
+
+/// Message sizes uniformly distributed over [state.range(0), state.range(1)]
+static auto messageSizes(benchmark::State const& state) {
+    auto sizes = std::vector<std::size_t>(4096);
+    auto engine = std::mt19937{42};
+    auto distribution = std::uniform_int_distribution<std::size_t>(
+        static_cast<std::size_t>(state.range(0)), static_cast<std::size_t>(state.range(1)));
+    for (auto& size : sizes) {
+        size = distribution(engine);
+    }
+    return sizes;
+}
+
+constexpr auto maxMessageSize = std::size_t{2048};
+
+/// Each message starts with its sequence number; -1 ends the run.
+void BM_ByteFifo(benchmark::State& state) {
+    using sequence_type = std::int64_t;
+
+    ByteFifo<> fifo(2*1024*1024);
+    auto sizes = messageSizes(state);
+
+    auto t = std::jthread([&] {
+        pinThread(cpu1);
+        std::byte buffer[maxMessageSize];
+        for (auto i = sequence_type{};; ++i) {
+            auto message = fifo.peek();
+            while (message.empty()) {
+                message = fifo.peek();
+            }
+            std::memcpy(buffer, message.data(), message.size());
+            fifo.release();
+            benchmark::DoNotOptimize(buffer);
+
+            auto sequence = sequence_type{};
+            std::memcpy(&sequence, buffer, sizeof(sequence));
+            if (sequence == -1) {
+                break;
+            }
+            if (sequence != i) {
+                throw std::runtime_error("invalid value");
+            }
+        }
+    });
+
+    auto sequence = sequence_type{};
+    auto bytes = std::int64_t{};
+    pinThread(cpu2);
+    for (auto _ : state) {
+        auto size = sizes[static_cast<std::size_t>(sequence) % sizes.size()];
+        auto buffer = fifo.reserve(size);
+        while (buffer.empty()) {
+            buffer = fifo.reserve(size);
+        }
+        std::memset(buffer.data(), 0xa5, size);
+        std::memcpy(buffer.data(), &sequence, sizeof(sequence));
+        fifo.commit();
+        ++sequence;
+        bytes += static_cast<std::int64_t>(size);
+    }
+    state.counters["ops/sec"] = benchmark::Counter(double(sequence), benchmark::Counter::kIsRate);
+    state.SetBytesProcessed(bytes);
+
+    sequence = -1;
+    while (not fifo.push(std::as_bytes(std::span(&sequence, 1)))) {
+        ;
+    }
+}
+
+
+/// A fixed size slot large enough for the largest message
+struct FixedMessage
+{
+    std::size_t size;
+    std::byte data[maxMessageSize];
+};
+
+/// Same as BM_ByteFifo but with a Fifo5a of worst case sized slots using
+/// about the same amount of memory for its ring.
+void BM_FixedMessageFifo(benchmark::State& state) {
+    using sequence_type = std::int64_t;
+
+    Fifo5a<FixedMessage> fifo(1024);
+    auto sizes = messageSizes(state);
+
+    auto t = std::jthread([&] {
+        pinThread(cpu1);
+        std::byte buffer[maxMessageSize];
+        for (auto i = sequence_type{};; ++i) {
+            {
+                auto popper = fifo.pop();
+                while (not popper) {
+                    popper = fifo.pop();
+                }
+                std::memcpy(buffer, popper->data, popper->size);
+            }
+            benchmark::DoNotOptimize(buffer);
+
+            auto sequence = sequence_type{};
+            std::memcpy(&sequence, buffer, sizeof(sequence));
+            if (sequence == -1) {
+                break;
+            }
+            if (sequence != i) {
+                throw std::runtime_error("invalid value");
+            }
+        }
+    });
+
+    auto sequence = sequence_type{};
+    auto bytes = std::int64_t{};
+    pinThread(cpu2);
+    for (auto _ : state) {
+        auto size = sizes[static_cast<std::size_t>(sequence) % sizes.size()];
+        {
+            auto pusher = fifo.push();
+            while (not pusher) {
+                pusher = fifo.push();
+            }
+            pusher->size = size;
+            std::memset(pusher->data, 0xa5, size);
+            std::memcpy(pusher->data, &sequence, sizeof(sequence));
+        }
+        ++sequence;
+        bytes += static_cast<std::int64_t>(size);
+    }
+    state.counters["ops/sec"] = benchmark::Counter(double(sequence), benchmark::Counter::kIsRate);
+    state.SetBytesProcessed(bytes);
+
+    auto pusher = fifo.push();
+    while (not pusher) {
+        pusher = fifo.push();
+    }
+    pusher->size = sizeof(sequence_type);
+    std::memcpy(pusher->data, &(sequence = -1), sizeof(sequence));
+}
+
+
 BENCHMARK_TEMPLATE(BM_Fifo, Fifo4);
 BENCHMARK_TEMPLATE(BM_Fifo, Fifo4a);
 BENCHMARK_TEMPLATE(BM_Fifo, Fifo5);
@@ -101,5 +442,39 @@ BENCHMARK_TEMPLATE(BM_Fifo, Fifo5a);
 BENCHMARK_TEMPLATE(BM_Fifo, Fifo5b);
 BENCHMARK_TEMPLATE(BM_Fifo, rigtorp::SPSCQueue);
 
+BENCHMARK_TEMPLATE(BM_FifoBatch, Fifo5, false)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_FifoBatch, Fifo5, true)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_FifoBatch, Fifo5a, false)->Arg(16)->Arg(256)->Arg(4096);
+BENCHMARK_TEMPLATE(BM_FifoBatch, Fifo5a, true)->Arg(16)->Arg(256)->Arg(4096);
+
+#define BENCHMARK_SWEEP(FifoT, ValueT, Size) \
+    static_assert(sizeof(ValueT<Size>) == Size); \
+    BENCHMARK_TEMPLATE(BM_Sweep, FifoT, ValueT<Size>)->Apply(sweepCapacities<Size>)
+
+BENCHMARK_SWEEP(Fifo5a, Payload, 8);
+BENCHMARK_SWEEP(Fifo5a, Payload, 32);
+BENCHMARK_SWEEP(Fifo5a, Payload, 64);
+BENCHMARK_SWEEP(Fifo5a, Payload, 128);
+BENCHMARK_SWEEP(Fifo5a, Payload, 256);
+BENCHMARK_SWEEP(Fifo5a, Payload, 512);
+BENCHMARK_SWEEP(Fifo5a, PartialPayload, 128);
+BENCHMARK_SWEEP(Fifo5a, PartialPayload, 256);
+BENCHMARK_SWEEP(Fifo5a, PartialPayload, 512);
+BENCHMARK_SWEEP(rigtorp::SPSCQueue, Payload, 8);
+BENCHMARK_SWEEP(rigtorp::SPSCQueue, Payload, 32);
+BENCHMARK_SWEEP(rigtorp::SPSCQueue, Payload, 64);
+BENCHMARK_SWEEP(rigtorp::SPSCQueue, Payload, 128);
+BENCHMARK_SWEEP(rigtorp::SPSCQueue, Payload, 256);
+BENCHMARK_SWEEP(rigtorp::SPSCQueue, Payload, 512);
+
+// std::allocator versus huge pages for rings beyond the TLB's reach
+BENCHMARK_TEMPLATE(BM_Sweep, Fifo5a, Payload<64>)->Apply(hugePageCapacities);
+BENCHMARK_TEMPLATE(BM_Sweep, Fifo5aHugePages, Payload<64>)->Apply(hugePageCapacities);
+
+// Message size distributions: fixed small, fixed large, uniform small,
+// uniform across the whole range
+BENCHMARK(BM_ByteFifo)->Args({16, 16})->Args({2048, 2048})->Args({16, 256})->Args({16, 2048});
+BENCHMARK(BM_FixedMessageFifo)->Args({16, 16})->Args({2048, 2048})->Args({16, 256})->Args({16, 2048});
+
 BENCHMARK_MAIN();
 
@@ -1,17 +1,30 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <span>
 #include <stdexcept>
 #include <thread>
 #include <utility>
 
 #include <pthread.h>
 
+// For ValueSizeTraits
+#include "Fifo5.hpp"
+#include "histogram.hpp"
+#include "perf.hpp"
+#include "tsc.hpp"
+
 template<typename T>
 inline __attribute__((always_inline)) void doNotOptimize(T const& value) {
     asm volatile("" : : "r,m" (value) : "memory");
@@ -34,6 +47,52 @@ static void pinThread(int cpu) {
 template<typename T>
 struct isRigtorp : std::false_type {};
 
+/// Push one value onto `q`, spinning while it is full
+template<typename T>
+void spinPush(T& q, typename T::value_type const& value) {
+    if constexpr(isRigtorp<T>::value) {
+        while (auto again = not q.try_push(value)) {
+            doNotOptimize(again);
+        }
+    } else {
+        while (auto again = not q.push(value)) {
+            doNotOptimize(again);
+        }
+    }
+}
+
+/// Pop one value from `q`, spinning while it is empty
+template<typename T>
+auto spinPop(T& q) {
+    typename T::value_type val;
+    if constexpr(isRigtorp<T>::value) {
+        while (auto again = not q.front()) {
+            doNotOptimize(again);
+        }
+        val = *q.front();
+        q.pop();
+    } else {
+        while (auto again = not q.pop(val)) {
+            doNotOptimize(again);
+        }
+    }
+    return val;
+}
+
+/// Hardware counters for each thread of a Bench run
+struct BenchCounters
+{
+    perf::Counts push;
+    perf::Counts pop;
+};
+
+/// Construct a `BenchT` on the heap and run it with `args`. Fifo5c holds
+/// its ring inline, so a bench of it is too large for the stack.
+template<typename BenchT, typename... Args>
+auto runBench(Args&&... args) {
+    return (*std::make_unique<BenchT>())(std::forward<Args>(args)...);
+}
+
 template<typename T>
 class Bench
 {
@@ -42,36 +101,73 @@ public:
 
     static constexpr auto fifoSize = 131072;
 
-    auto operator()(long iters, int cpu1, int cpu2) {
+    Bench() = default;
+
+    /// Construct the fifo with `args` after the capacity, e.g. an allocator
+    template<typename... Args>
+    explicit Bench(std::in_place_t, Args&&... args) : q{fifoSize, std::forward<Args>(args)...} {}
+
+    /// @param counters if not null, count hardware events on both threads
+    /// during the benchmark run and store them here
+    auto operator()(long iters, int cpu1, int cpu2, BenchCounters* counters = nullptr) {
         using namespace std::chrono_literals;
 
         auto t = std::jthread([&] {
             pinThread(cpu1);
+            auto perf = std::optional<perf::Counters>{};
+            if (counters) {
+                perf.emplace();
+            }
+
             // pop warmup
             for (auto i = value_type{}; i < fifoSize; ++i) {
                 pop(i);
             }
+            flushPop();
 
             // pop benchmark run
+            if (perf) {
+                perf->start();
+            }
             for (auto i = value_type{}; i < iters; ++i) {
                 pop(i);
             }
+            flushPop();
+            if (perf) {
+                perf->stop();
+                counters->pop = perf->read();
+            }
         });
 
         pinThread(cpu2);
+        auto perf = std::optional<perf::Counters>{};
+        if (counters) {
+            perf.emplace();
+        }
+
         // push warmup
         for (auto i = value_type{}; i < fifoSize; ++i) {
             push(i);
         }
+        flushPush();
         waitForEmpty();
 
         // push benchmark run
+        if (perf) {
+            perf->start();
+        }
         auto start = std::chrono::steady_clock::now();
         for (auto i = value_type{}; i < iters; ++i) {
             push(i);
         }
+        flushPush();
         waitForEmpty();
         auto stop = std::chrono::steady_clock::now();
+        if (perf) {
+            perf->stop();
+            counters->push = perf->read();
+        }
+        t.join();
 
         auto delta = stop - start;
         return (iters * 1s)/delta;
@@ -79,35 +175,97 @@ public:
 
 private:
     void pop(value_type expected) {
-        value_type val;
-        if constexpr(isRigtorp<T>::value) {
-            while (auto again = not q.front()) {
-                doNotOptimize(again);
-	    }
-            val = *q.front();
-            q.pop();
-        } else {
-            while (auto again = not q.pop(val)) {
-                doNotOptimize(again);
-	    }
-        }
-        if (val != expected) {
+        if (spinPop(q) != expected) {
             throw std::runtime_error("invalid value");
         }
     }
 
     void push(value_type i) {
-        if constexpr(isRigtorp<T>::value) {
-            while (auto again = not q.try_push(i)) {
-                doNotOptimize(again);
-            }
-        } else {
-            while (auto again = not q.push(i)) {
-                doNotOptimize(again);
+        spinPush(q, i);
+    }
+
+    /// Publish any deferred pushes or pops, for fifos such as Fifo5d
+    void flushPush() {
+        if constexpr (requires { q.flushPush(); }) {
+            q.flushPush();
+        }
+    }
+    void flushPop() {
+        if constexpr (requires { q.flushPop(); }) {
+            q.flushPop();
+        }
+    }
+
+    void waitForEmpty() {
+        while (auto again = not q.empty()) {
+            doNotOptimize(again);
+        }
+    };
+
+private:
+    T q{fifoSize};
+};
+
+
+/// Like Bench but moves elements through the fifo's span-based pushUpTo()
+/// and popUpTo() in batches of up to BatchSize elements.
+template<typename T, std::size_t BatchSize = 256>
+class BulkBench
+{
+public:
+    using value_type = typename T::value_type;
+
+    static constexpr auto fifoSize = 131072;
+
+    auto operator()(long iters, int cpu1, int cpu2) {
+        using namespace std::chrono_literals;
+
+        auto t = std::jthread([&] {
+            pinThread(cpu1);
+            // pop warmup
+            pop(fifoSize);
+
+            // pop benchmark run
+            pop(iters);
+        });
+
+        pinThread(cpu2);
+        // push warmup
+        push(fifoSize);
+        waitForEmpty();
+
+        // push benchmark run
+        auto start = std::chrono::steady_clock::now();
+        push(iters);
+        waitForEmpty();
+        auto stop = std::chrono::steady_clock::now();
+
+        auto delta = stop - start;
+        return (iters * 1s)/delta;
+    }
+
+private:
+    void pop(long count) {
+        std::array<value_type, BatchSize> batch;
+        for (auto i = value_type{}; i < count;) {
+            auto popped = q.popUpTo(batch);
+            for (auto val : std::span(batch).first(popped)) {
+                if (val != i++) {
+                    throw std::runtime_error("invalid value");
+                }
             }
         }
     }
 
+    void push(long count) {
+        std::array<value_type, BatchSize> batch;
+        for (auto i = value_type{}; i < count;) {
+            auto n = std::min(BatchSize, static_cast<std::size_t>(count - i));
+            std::iota(batch.begin(), batch.begin() + n, i);
+            i += static_cast<value_type>(q.pushUpTo(std::span<value_type const>(batch.data(), n)));
+        }
+    }
+
     void waitForEmpty() {
         while (auto again = not q.empty()) {
             doNotOptimize(again);
@@ -119,10 +277,157 @@ private:
 };
 
 
+/// Round trip latency between two pinned threads. The timing thread pushes
+/// onto a request fifo and spins until the echo thread pushes the value
+/// back onto a reply fifo. Each round trip is timed with rdtsc().
+template<typename T>
+class PingPong
+{
+public:
+    using value_type = typename T::value_type;
+
+    static constexpr auto fifoSize = 131072;
+
+    /// @return a histogram of round trip times in rdtsc() ticks
+    auto operator()(long iters, int cpu1, int cpu2) {
+        constexpr auto warmup = value_type{fifoSize};
+
+        auto t = std::jthread([&] {
+            pinThread(cpu1);
+            for (auto i = value_type{}; i < warmup + iters; ++i) {
+                spinPush(reply, spinPop(request));
+            }
+        });
+
+        pinThread(cpu2);
+        for (auto i = value_type{}; i < warmup; ++i) {
+            spinPush(request, i);
+            spinPop(reply);
+        }
+
+        auto histogram = LogHistogram<>{};
+        for (auto i = value_type{}; i < iters; ++i) {
+            auto start = rdtsc();
+            spinPush(request, i);
+            auto val = spinPop(reply);
+            auto stop = rdtsc();
+
+            histogram.record(stop - start);
+            if (val != i) {
+                throw std::runtime_error("invalid value");
+            }
+        }
+        return histogram;
+    }
+
+private:
+    T request{fifoSize};
+    T reply{fifoSize};
+};
+
+
+/// Element type for OneWay: a sequence number and an rdtsc() push time
+/// padded out to Size bytes. Specializing ValueSizeTraits means fifos that
+/// use it copy only the first two members.
+template<std::size_t Size = 64>
+struct StampedValue
+{
+    static_assert(Size > 2*sizeof(std::int64_t));
+
+    std::int64_t sequence;
+    std::uint64_t tsc;
+    char padding[Size - 2*sizeof(std::int64_t)];
+};
+
+template<std::size_t Size>
+struct ValueSizeTraits<StampedValue<Size>>
+{
+    using value_type = StampedValue<Size>;
+    static std::size_t size(value_type const&) { return offsetof(value_type, padding); }
+};
+
+/// Enqueue to dequeue latency under load. The push thread stamps each
+/// element as it is pushed and the pop thread records rdtsc() minus the
+/// stamp. If `rate` is non-zero the push thread is paced to that many
+/// pushes per second and stamps each element with its scheduled push time,
+/// so a push thread that falls behind schedule does not hide the delay.
+/// With a `burst` of more than 1 the same average rate is offered as bursts
+/// of that many back-to-back pushes, each stamped with the burst's time;
+/// `burst` must be at least 1.
+template<typename T>
+class OneWay
+{
+public:
+    using value_type = typename T::value_type;
+
+    static constexpr auto fifoSize = 131072;
+
+    struct Result
+    {
+        LogHistogram<> latency;  ///< rdtsc() ticks
+        long opsPerSec;
+    };
+
+    auto operator()(long iters, double rate, int cpu1, int cpu2, long burst = 1) {
+        using namespace std::chrono_literals;
+
+        constexpr auto warmup = std::int64_t{fifoSize};
+        auto histogram = LogHistogram<>{};
+        auto stop = std::chrono::steady_clock::time_point{};
+
+        auto t = std::jthread([&] {
+            pinThread(cpu1);
+            for (auto i = std::int64_t{}; i < warmup + iters; ++i) {
+                auto val = spinPop(q);
+                auto now = rdtsc();
+                if (val.sequence != i) {
+                    throw std::runtime_error("invalid value");
+                }
+                if (i >= warmup) {
+                    histogram.record(now - std::min(now, val.tsc));
+                }
+            }
+            stop = std::chrono::steady_clock::now();
+        });
+
+        pinThread(cpu2);
+        auto ticksPerBurst = rate > 0 ? double(burst) * 1e9 / rate / tscNanosecondsPerTick() : 0.0;
+        auto start = std::chrono::steady_clock::now();
+        auto scheduled = double(rdtsc());
+        for (auto i = std::int64_t{}; i < warmup + iters; ++i) {
+            if (i == warmup) {
+                start = std::chrono::steady_clock::now();
+                scheduled = double(rdtsc());
+            }
+            auto val = value_type{};
+            val.sequence = i;
+            if (rate > 0) {
+                if (i % burst == 0) {
+                    scheduled += ticksPerBurst;
+                    while (double(rdtsc()) < scheduled) {
+                        ;
+                    }
+                }
+                val.tsc = static_cast<std::uint64_t>(scheduled);
+            } else {
+                val.tsc = rdtsc();
+            }
+            spinPush(q, val);
+        }
+        t.join();
+
+        return Result{histogram, (iters * 1s)/(stop - start)};
+    }
+
+private:
+    T q{fifoSize};
+};
+
+
 // "legacy" API
 template<typename T>
 auto bench(char const* name, long iters, int cpu1, int cpu2) {
-    return Bench<T>{}(iters, cpu1, cpu2);
+    return runBench<Bench<T>>(iters, cpu1, cpu2);
 }
 
 
@@ -1,3 +1,7 @@
+#include "AlignedAllocator.hpp"
+#include "BQueue.hpp"
+#include "FastForwardFifo.hpp"
+#include "Fifo.hpp"
 #include "Fifo2.hpp"
 #include "Fifo3.hpp"
 #include "Fifo4.hpp"
@@ -6,13 +10,24 @@
 #include "Fifo5.hpp"
 #include "Fifo5a.hpp"
 #include "Fifo5b.hpp"
+#include "Fifo5c.hpp"
+#include "Fifo5d.hpp"
+#include "FifoLayout.hpp"
 #include "Mutex.hpp"
+#include "NumaAllocator.hpp"
+#include "UnboundedFifo.hpp"
 #include "rigtorp.hpp"
 #include <boost/lockfree/spsc_queue.hpp>   // boost 1.74.0
 
 #include "bench.hpp"
+#include "topology.hpp"
 
+#include <iomanip>
 #include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
 
 
 template<typename ValueT>
@@ -23,6 +38,17 @@ struct isRigtorp<rigtorp::SPSCQueue<ValueT>> : std::true_type {};
 template<typename T>
 using boost_spsc_queue = boost::lockfree::spsc_queue<T, boost::lockfree::fixed_sized<true>>;
 
+// Configuring capacity to match Bench's fifoSize
+template<typename T>
+using fixed_fifo5c = Fifo5c<T, Bench<Fifo5a<T>>::fifoSize>;
+
+
+// Fifo4 and Fifo5 take a statistics policy before the layout
+template<typename T, typename Alloc, typename Layout>
+using fifo4_layout = Fifo4<T, Alloc, NoStats, Layout>;
+template<typename T, typename Alloc, typename Layout>
+using fifo5_layout = Fifo5<T, Alloc, NoStats, Layout>;
+
 
 template<typename ValueT>
 void once(long iters, int cpu1, int cpu2) {
@@ -37,26 +63,349 @@ void once(long iters, int cpu1, int cpu2) {
         Bench<Fifo5<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
         Bench<Fifo5a<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
         Bench<Fifo5b<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
+        runBench<Bench<fixed_fifo5c<ValueT>>>(iters, cpu1, cpu2) << "," << std::flush <<
+        Bench<UnboundedFifo<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
+        Bench<FastForwardFifo<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
+        BulkBench<Fifo5<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
+        BulkBench<Fifo5a<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
         Bench<rigtorp::SPSCQueue<ValueT>>{}(iters, cpu1, cpu2) << "," << std::flush <<
         Bench<boost_spsc_queue<ValueT>>{}(iters, cpu1, cpu2) << std::flush <<
         "\n";
 }
 
+/// Calls `f.template operator()<FifoT>(name)` for each SPSC fifo compared
+template<typename ValueT, typename F>
+void forEachFifo(F&& f) {
+    f.template operator()<Fifo3<ValueT>>("Fifo3");
+    f.template operator()<Fifo4<ValueT>>("Fifo4");
+    f.template operator()<Fifo4a<ValueT>>("Fifo4a");
+    f.template operator()<Fifo4b<ValueT>>("Fifo4b");
+    f.template operator()<Fifo5<ValueT>>("Fifo5");
+    f.template operator()<Fifo5a<ValueT>>("Fifo5a");
+    f.template operator()<Fifo5b<ValueT>>("Fifo5b");
+    f.template operator()<fixed_fifo5c<ValueT>>("Fifo5c");
+    f.template operator()<UnboundedFifo<ValueT>>("UnboundedFifo");
+    f.template operator()<FastForwardFifo<ValueT>>("FastForwardFifo");
+    f.template operator()<rigtorp::SPSCQueue<ValueT>>("rigtorp");
+    f.template operator()<boost_spsc_queue<ValueT>>("boost_spsc_queue");
+}
+
+template<typename ValueT>
+void pingPong(long iters, int cpu1, int cpu2) {
+    forEachFifo<ValueT>([&]<typename FifoT>(char const* name) {
+        auto histogram = runBench<PingPong<FifoT>>(iters, cpu1, cpu2);
+        std::cout << name << std::fixed << std::setprecision(1)
+            << "," << tscToNanoseconds(histogram.percentile(50))
+            << "," << tscToNanoseconds(histogram.percentile(99))
+            << "," << tscToNanoseconds(histogram.percentile(99.9))
+            << "," << tscToNanoseconds(histogram.max()) << std::endl;
+    });
+}
+
+/// Throughput of each fifo over one core pair per level of cache sharing.
+/// Prints a matrix with a row per fifo and a column per core pair.
+template<typename ValueT>
+void matrix(long iters, std::vector<topology::CpuPair> const& pairs) {
+    constexpr auto nameWidth = 18;
+    constexpr auto columnWidth = 22;
+
+    std::cout << std::setw(nameWidth) << std::left << "ops/s";
+    for (auto const& pair : pairs) {
+        auto label = std::string(topology::name(pair.sharing))
+            + " (" + std::to_string(pair.cpu1) + "," + std::to_string(pair.cpu2) + ")";
+        std::cout << std::setw(columnWidth) << std::right << label;
+    }
+    std::cout << std::endl;
+
+    forEachFifo<ValueT>([&]<typename FifoT>(char const* name) {
+        std::cout << std::setw(nameWidth) << std::left << name << std::flush;
+        for (auto const& pair : pairs) {
+            std::cout << std::setw(columnWidth) << std::right
+                << runBench<Bench<FifoT>>(iters, pair.cpu1, pair.cpu2) << std::flush;
+        }
+        std::cout << std::endl;
+    });
+}
+
+/// Throughput plus hardware events per operation on each thread. Events
+/// that are not available are left blank.
+template<typename ValueT>
+void perfCounters(long iters, int cpu1, int cpu2) {
+    forEachFifo<ValueT>([&]<typename FifoT>(char const* name) {
+        auto counters = BenchCounters{};
+        auto opsPerSec = runBench<Bench<FifoT>>(iters, cpu1, cpu2, &counters);
+        std::cout << name << "," << opsPerSec << std::fixed << std::setprecision(3);
+        for (auto const& counts : {counters.push, counters.pop}) {
+            for (auto const& count : counts) {
+                std::cout << ",";
+                if (count) {
+                    std::cout << double(*count) / double(iters);
+                }
+            }
+        }
+        std::cout << std::defaultfloat << std::endl;
+    });
+}
+
+/// Throughput and one-way latency of the shared cursor, per-slot flag and
+/// batched probe designs under light, bursty and saturated loads. Light
+/// and bursty offer the same average rate, bursty as back-to-back runs.
+template<typename ValueT>
+void loads(long iters, double rate, long burst, int cpu1, int cpu2) {
+    struct Load { char const* name; double rate; long burst; };
+    auto const loads = {Load{"light", rate, 1}, Load{"bursty", rate, burst}, Load{"saturated", 0, 1}};
+
+    auto run = [&]<typename FifoT>(char const* name) {
+        for (auto const& load : loads) {
+            auto result = OneWay<FifoT>{}(iters, load.rate, cpu1, cpu2, load.burst);
+            std::cout << name << "," << load.name << "," << result.opsPerSec << std::fixed << std::setprecision(1)
+                << "," << tscToNanoseconds(result.latency.percentile(50))
+                << "," << tscToNanoseconds(result.latency.percentile(99))
+                << "," << tscToNanoseconds(result.latency.percentile(99.9))
+                << "," << tscToNanoseconds(result.latency.max()) << std::defaultfloat << std::endl;
+        }
+    };
+    run.template operator()<Fifo5a<ValueT>>("Fifo5a");
+    run.template operator()<FastForwardFifo<ValueT>>("FastForwardFifo");
+    run.template operator()<BQueue<ValueT, std::allocator<ValueT>, 8>>("BQueue 8");
+    run.template operator()<BQueue<ValueT, std::allocator<ValueT>, 64>>("BQueue 64");
+    run.template operator()<BQueue<ValueT, std::allocator<ValueT>, 512>>("BQueue 512");
+}
+
+/// Footprint and throughput of Fifo3 to Fifo5b for each cursor layout,
+/// with the ring from std::allocator or aligned by AlignedAllocator
+template<typename ValueT>
+void layouts(long iters, int cpu1, int cpu2) {
+    auto run = [&]<template<typename, typename, typename> class FifoT>(char const* name) {
+        auto runOne = [&]<typename Alloc, typename Layout>(char const* allocName, char const* layoutName) {
+            using fifo_type = FifoT<ValueT, Alloc, Layout>;
+            std::cout << name << "," << layoutName << "," << allocName << "," << sizeof(fifo_type)
+                << "," << Bench<fifo_type>{}(iters, cpu1, cpu2) << std::endl;
+        };
+        runOne.template operator()<std::allocator<ValueT>, CompactLayout>("std::allocator", "compact");
+        runOne.template operator()<std::allocator<ValueT>, Padded64Layout>("std::allocator", "64");
+        runOne.template operator()<std::allocator<ValueT>, Padded128Layout>("std::allocator", "128");
+        runOne.template operator()<AlignedAllocator<ValueT>, CompactLayout>("aligned", "compact");
+        runOne.template operator()<AlignedAllocator<ValueT>, Padded64Layout>("aligned", "64");
+        runOne.template operator()<AlignedAllocator<ValueT>, Padded128Layout>("aligned", "128");
+    };
+    run.template operator()<Fifo3>("Fifo3");
+    run.template operator()<fifo4_layout>("Fifo4");
+    run.template operator()<Fifo4a>("Fifo4a");
+    run.template operator()<Fifo4b>("Fifo4b");
+    run.template operator()<fifo5_layout>("Fifo5");
+    run.template operator()<Fifo5a>("Fifo5a");
+    run.template operator()<Fifo5b>("Fifo5b");
+}
+
+/// Calls `f.template operator()<T>()` for each of Ts
+template<typename... Ts, typename F>
+void forEachType(F&& f) {
+    (f.template operator()<Ts>(), ...);
+}
+
+template<typename Policy> constexpr char const* policyName = nullptr;
+template<> constexpr char const* policyName<ModuloIndex> = "modulo";
+template<> constexpr char const* policyName<MaskIndex> = "mask";
+template<> constexpr char const* policyName<ConstrainedIndex> = "constrained";
+template<> constexpr char const* policyName<AtomicCursor> = "atomic";
+template<> constexpr char const* policyName<AtomicRefCursor> = "atomic_ref";
+template<> constexpr char const* policyName<std::false_type> = "uncached";
+template<> constexpr char const* policyName<std::true_type> = "cached";
+template<> constexpr char const* policyName<AcquireReleaseOrder> = "acq_rel";
+template<> constexpr char const* policyName<SeqCstOrder> = "seq_cst";
+
+/// Throughput of Fifo for every combination of its index, cursor storage,
+/// caching and memory order policies
+template<typename ValueT>
+void policies(long iters, int cpu1, int cpu2) {
+    forEachType<ModuloIndex, MaskIndex, ConstrainedIndex>([&]<typename Index> {
+        forEachType<AtomicCursor, AtomicRefCursor>([&]<typename Cursor> {
+            forEachType<std::false_type, std::true_type>([&]<typename Cached> {
+                forEachType<AcquireReleaseOrder, SeqCstOrder>([&]<typename Order> {
+                    using fifo_type = Fifo<ValueT, std::allocator<ValueT>, Index, Cursor, Cached::value, Order>;
+                    std::cout << policyName<Index> << "," << policyName<Cursor>
+                        << "," << policyName<Cached> << "," << policyName<Order>
+                        << "," << Bench<fifo_type>{}(iters, cpu1, cpu2) << std::endl;
+                });
+            });
+        });
+    });
+}
+
+/// Throughput of Fifo5a, which publishes each push and pop, against
+/// Fifo5d publishing every K pushes and pops
+template<typename ValueT>
+void deferred(long iters, int cpu1, int cpu2) {
+    auto run = [&]<typename FifoT>(char const* name, std::size_t batch) {
+        std::cout << name << "," << batch << "," << Bench<FifoT>{}(iters, cpu1, cpu2) << std::endl;
+    };
+    run.template operator()<Fifo5a<ValueT>>("Fifo5a", 1);
+    run.template operator()<Fifo5d<ValueT, 1, 1>>("Fifo5d", 1);
+    run.template operator()<Fifo5d<ValueT, 4, 4>>("Fifo5d", 4);
+    run.template operator()<Fifo5d<ValueT, 16, 16>>("Fifo5d", 16);
+    run.template operator()<Fifo5d<ValueT, 64, 64>>("Fifo5d", 64);
+    run.template operator()<Fifo5d<ValueT, 256, 256>>("Fifo5d", 256);
+}
+
+/// Throughput of Fifo5 over a same-node and a cross-node core pair with
+/// the fifo, so its cursors, and its ring placed by first touch from the
+/// main thread, on the push thread's node, or on the pop thread's node.
+template<typename ValueT>
+void numaPlacement(long iters, std::vector<topology::CpuPair> const& pairs) {
+    using FifoT = Fifo5<ValueT, NumaAllocator<ValueT>>;
+    using BenchT = Bench<FifoT>;
+
+    auto nodes = std::vector<int>{};
+    for (auto const& cpu : topology::cpus()) {
+        if (std::size_t(cpu.id) >= nodes.size()) {
+            nodes.resize(std::size_t(cpu.id) + 1, -1);
+        }
+        nodes[std::size_t(cpu.id)] = cpu.node;
+    }
+
+    for (auto const& pair : pairs) {
+        // Bench pops on cpu1 and pushes on cpu2
+        auto pushNode = nodes[std::size_t(pair.cpu2)];
+        auto popNode = nodes[std::size_t(pair.cpu1)];
+        auto pairName = std::string(pushNode == popNode ? "same-node" : "cross-node")
+            + " (" + std::to_string(pair.cpu1) + "," + std::to_string(pair.cpu2) + ")";
+
+        for (auto [placement, node] : {std::pair{"first touch", -1}, {"push node", pushNode}, {"pop node", popNode}}) {
+            auto* memory = numa::allocate(sizeof(BenchT), node);
+            auto* bench = new (memory) BenchT(std::in_place, NumaAllocator<ValueT>(node));
+            auto opsPerSec = (*bench)(iters, pair.cpu1, pair.cpu2);
+            bench->~BenchT();
+            numa::deallocate(memory, sizeof(BenchT));
+            std::cout << pairName << "," << placement << "," << opsPerSec << std::endl;
+        }
+    }
+}
+
+/// One-way latency versus offered load; a rate of 0 pushes flat out
+template<typename ValueT>
+void oneWay(long iters, std::vector<double> const& rates, int cpu1, int cpu2) {
+    auto run = [&]<typename FifoT>(char const* name) {
+        for (auto rate : rates) {
+            auto result = OneWay<FifoT>{}(iters, rate, cpu1, cpu2);
+            std::cout << name << "," << rate << "," << result.opsPerSec << std::fixed << std::setprecision(1)
+                << "," << tscToNanoseconds(result.latency.percentile(50))
+                << "," << tscToNanoseconds(result.latency.percentile(99))
+                << "," << tscToNanoseconds(result.latency.percentile(99.9))
+                << "," << tscToNanoseconds(result.latency.max()) << std::defaultfloat << std::endl;
+        }
+    };
+    run.template operator()<Fifo4<ValueT>>("Fifo4");
+    run.template operator()<Fifo5a<ValueT>>("Fifo5a");
+    run.template operator()<Fifo5b<ValueT>>("Fifo5b");
+    run.template operator()<rigtorp::SPSCQueue<ValueT>>("rigtorp");
+    run.template operator()<boost_spsc_queue<ValueT>>("boost_spsc_queue");
+}
+
 int main(int argc, char* argv[]) {
     constexpr auto cpu1 = 1;
     constexpr auto cpu2 = 2;
     constexpr auto iters = 400'000'000l;
+    constexpr auto roundTrips = 10'000'000l;
+    constexpr auto oneWayIters = 5'000'000l;
+    constexpr auto matrixIters = 100'000'000l;
+    constexpr auto perfIters = 100'000'000l;
 
     auto reps = 10;
-    if (argc == 2) {
+    if (argc >= 2) {
        reps = std::atoi(argv[1]);
     }
+    auto mode = std::string_view(argc >= 3 ? argv[2] : "throughput");
 
     using value_type = std::int64_t;
 
-    std::cout << "Fifo3,Fifo4,Fifo4a,Fifo4b,Fifo5,Fifo5a,Fifo5b,rigtorp,boost_spsc_queue" << std::endl;
-    // std::cout << "Fifo2,Mutex\n";
-    for (auto rep = 0; rep < reps; ++rep) {
-        once<value_type>(iters, cpu1, cpu2);
+    if (mode == "throughput") {
+        std::cout << "Fifo3,Fifo4,Fifo4a,Fifo4b,Fifo5,Fifo5a,Fifo5b,Fifo5c,UnboundedFifo,FastForwardFifo,Fifo5 bulk,Fifo5a bulk,rigtorp,boost_spsc_queue" << std::endl;
+        // std::cout << "Fifo2,Mutex\n";
+        for (auto rep = 0; rep < reps; ++rep) {
+            once<value_type>(iters, cpu1, cpu2);
+        }
+    } else if (mode == "pingpong") {
+        std::cout << "fifo,p50 ns,p99 ns,p99.9 ns,max ns" << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            pingPong<value_type>(roundTrips, cpu1, cpu2);
+        }
+    } else if (mode == "oneway") {
+        // pushes per second; 0 is unpaced
+        auto rates = std::vector<double>{1e6, 5e6, 10e6, 20e6, 50e6, 0};
+        if (argc >= 4) {
+            rates = {std::atof(argv[3])};
+        }
+        std::cout << "fifo,rate,ops/s,p50 ns,p99 ns,p99.9 ns,max ns" << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            oneWay<StampedValue<>>(oneWayIters, rates, cpu1, cpu2);
+        }
+    } else if (mode == "matrix") {
+        auto pairs = topology::representativePairs();
+        if (pairs.empty()) {
+            std::cerr << "matrix needs at least two usable CPUs with known packages\n";
+            return EXIT_FAILURE;
+        }
+        for (auto rep = 0; rep < reps; ++rep) {
+            matrix<value_type>(matrixIters, pairs);
+        }
+    } else if (mode == "perf") {
+        if (not perf::Counters{}.available()) {
+            std::cerr << "hardware counters are not available; reporting ops/s only\n";
+        }
+        std::cout << "fifo,ops/s";
+        for (auto side : {"push", "pop"}) {
+            for (auto event = 0; event < perf::eventCount; ++event) {
+                std::cout << "," << side << " " << perf::name(static_cast<perf::Event>(event)) << "/op";
+            }
+        }
+        std::cout << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            perfCounters<value_type>(perfIters, cpu1, cpu2);
+        }
+    } else if (mode == "deferred") {
+        std::cout << "fifo,K,ops/s" << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            deferred<value_type>(iters, cpu1, cpu2);
+        }
+    } else if (mode == "layout") {
+        std::cout << "fifo,layout,allocator,bytes,ops/s" << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            layouts<value_type>(iters, cpu1, cpu2);
+        }
+    } else if (mode == "policies") {
+        std::cout << "index,cursor,cached,order,ops/s" << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            policies<value_type>(iters, cpu1, cpu2);
+        }
+    } else if (mode == "loads") {
+        // Average pushes per second for light and bursty, and burst length
+        auto rate = argc >= 4 ? std::atof(argv[3]) : 1e6;
+        auto burst = argc >= 5 ? std::atol(argv[4]) : 256l;
+        if (burst < 1) {
+            std::cerr << "burst must be a positive number of pushes\n";
+            return EXIT_FAILURE;
+        }
+        std::cout << "fifo,load,ops/s,p50 ns,p99 ns,p99.9 ns,max ns" << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            loads<StampedValue<>>(oneWayIters, rate, burst, cpu1, cpu2);
+        }
+    } else if (mode == "numa") {
+        // Single node machines can be split with the numa=fake=N boot option
+        auto pairs = topology::nodePairs();
+        if (pairs.empty()) {
+            std::cerr << "numa needs at least two usable CPUs with known NUMA nodes\n";
+            return EXIT_FAILURE;
+        }
+        if (pairs.size() == 1) {
+            std::cerr << "only one of a same-node and a cross-node pair is present\n";
+        }
+        std::cout << "pair,placement,ops/s" << std::endl;
+        for (auto rep = 0; rep < reps; ++rep) {
+            numaPlacement<value_type>(matrixIters, pairs);
+        }
+    } else {
+        std::cerr << "usage: " << argv[0] << " [reps [throughput|pingpong|oneway [rate]|matrix|perf|numa|deferred|layout|policies|loads [rate [burst]]]]\n";
+        return EXIT_FAILURE;
     }
 }
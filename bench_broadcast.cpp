@@ -0,0 +1,106 @@
+#include "BroadcastFifo.hpp"
+#include "Fifo5.hpp"
+#include "bench.hpp"
+#include "topology.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+constexpr auto fifoSize = 131072;
+
+/// Delivers `iters` elements to each of `consumers` pop threads through one
+/// BroadcastFifo.
+/// @param cpus CPUs to pin to, push thread first; threads beyond the end of
+/// `cpus` are not pinned
+/// @return elements pushed per second
+template<typename ValueT>
+long broadcast(long iters, int consumers, std::vector<int> const& cpus) {
+    using namespace std::chrono_literals;
+
+    auto fifo = BroadcastFifo<ValueT>(fifoSize, std::size_t(consumers));
+    auto threads = std::vector<std::jthread>{};
+    for (auto consumer = 0; consumer < consumers; ++consumer) {
+        threads.emplace_back([&, consumer] {
+            pinThread(topology::cpuFor(cpus, consumer + 1));
+            for (auto i = ValueT{}; i < iters; ++i) {
+                auto value = ValueT{};
+                while (not fifo.pop(std::size_t(consumer), value)) {
+                    ;
+                }
+                if (value != i) {
+                    throw std::runtime_error("invalid value");
+                }
+            }
+        });
+    }
+
+    pinThread(topology::cpuFor(cpus, 0));
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = ValueT{}; i < iters; ++i) {
+        while (auto again = not fifo.push(i)) {
+            doNotOptimize(again);
+        }
+    }
+    threads.clear();
+    auto stop = std::chrono::steady_clock::now();
+
+    return (iters * 1s)/(stop - start);
+}
+
+/// Delivers `iters` elements to each of `consumers` pop threads by pushing
+/// a copy onto a separate Fifo5 per pop thread.
+/// @param cpus as for broadcast()
+/// @return elements pushed per second
+template<typename ValueT>
+long fifoPerConsumer(long iters, int consumers, std::vector<int> const& cpus) {
+    using namespace std::chrono_literals;
+
+    auto fifos = std::vector<std::unique_ptr<Fifo5<ValueT>>>{};
+    for (auto consumer = 0; consumer < consumers; ++consumer) {
+        fifos.push_back(std::make_unique<Fifo5<ValueT>>(fifoSize));
+    }
+    auto threads = std::vector<std::jthread>{};
+    for (auto consumer = 0; consumer < consumers; ++consumer) {
+        threads.emplace_back([&, consumer] {
+            pinThread(topology::cpuFor(cpus, consumer + 1));
+            auto& fifo = *fifos[std::size_t(consumer)];
+            for (auto i = ValueT{}; i < iters; ++i) {
+                if (spinPop(fifo) != i) {
+                    throw std::runtime_error("invalid value");
+                }
+            }
+        });
+    }
+
+    pinThread(topology::cpuFor(cpus, 0));
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = ValueT{}; i < iters; ++i) {
+        for (auto& fifo : fifos) {
+            spinPush(*fifo, i);
+        }
+    }
+    threads.clear();
+    auto stop = std::chrono::steady_clock::now();
+
+    return (iters * 1s)/(stop - start);
+}
+
+int main() {
+    constexpr auto iters = 20'000'000l;
+    constexpr auto maxConsumers = 8;
+
+    auto cpus = topology::cpuIds();
+
+    using value_type = std::int64_t;
+
+    std::cout << "consumers,BroadcastFifo,Fifo5 per consumer" << std::endl;
+    for (auto consumers = 1; consumers <= maxConsumers; ++consumers) {
+        std::cout << consumers << "," << std::flush
+            << broadcast<value_type>(iters, consumers, cpus) << "," << std::flush
+            << fifoPerConsumer<value_type>(iters, consumers, cpus) << std::endl;
+    }
+}
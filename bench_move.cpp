@@ -0,0 +1,167 @@
+#include "Fifo4.hpp"
+#include "Fifo5e.hpp"
+#include "bench.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+
+
+// Count every allocation in the process
+static std::atomic<std::uint64_t> allocations{};
+
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+
+/// A message that owns heap memory and counts its copies
+struct Message
+{
+    static inline std::atomic<std::uint64_t> copies{};
+
+    std::int64_t sequence;
+    std::string text;
+
+    Message() = default;
+    Message(std::int64_t sequence, std::string text) : sequence{sequence}, text{std::move(text)} {}
+    Message(Message const& other) : sequence{other.sequence}, text{other.text} {
+        copies.fetch_add(1, std::memory_order_relaxed);
+    }
+    Message(Message&&) noexcept = default;
+    Message& operator=(Message const& other) {
+        copies.fetch_add(1, std::memory_order_relaxed);
+        sequence = other.sequence;
+        text = other.text;
+        return *this;
+    }
+    Message& operator=(Message&&) noexcept = default;
+};
+
+/// Longer than std::string's small buffer
+static auto const text = std::string(100, 'x');
+
+struct Result
+{
+    long opsPerSec;
+    double allocationsPerOp;
+    double copiesPerOp;
+};
+
+/// Moves `iters` Messages from the push thread on cpu2 to the pop thread on
+/// cpu1. `push(fifo, i)` pushes message `i` and `pop(fifo)` pops one and
+/// returns its sequence, or -1 if the fifo is empty.
+template<typename FifoT, typename Push, typename Pop>
+Result run(long iters, int cpu1, int cpu2, Push push, Pop pop) {
+    using namespace std::chrono_literals;
+
+    auto fifo = FifoT(131072);
+    auto allocationsBefore = allocations.load();
+    auto copiesBefore = Message::copies.load();
+
+    auto t = std::jthread([&] {
+        pinThread(cpu1);
+        for (auto i = std::int64_t{}; i < iters; ++i) {
+            auto sequence = pop(fifo);
+            while (sequence == -1) {
+                sequence = pop(fifo);
+            }
+            if (sequence != i) {
+                throw std::runtime_error("invalid value");
+            }
+        }
+    });
+
+    pinThread(cpu2);
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = std::int64_t{}; i < iters; ++i) {
+        while (auto again = not push(fifo, i)) {
+            doNotOptimize(again);
+        }
+    }
+    t.join();
+    auto stop = std::chrono::steady_clock::now();
+
+    return {
+        (iters * 1s)/(stop - start),
+        double(allocations.load() - allocationsBefore) / double(iters),
+        double(Message::copies.load() - copiesBefore) / double(iters)};
+}
+
+int main(int argc, char* argv[]) {
+    int cpu1 = 1;
+    int cpu2 = 2;
+    if (argc == 3) {
+       cpu1 = std::atoi(argv[1]);
+       cpu2 = std::atoi(argv[2]);
+    }
+
+    constexpr auto iters = 20'000'000l;
+
+    auto print = [](char const* name, Result const& result) {
+        std::cout << name << "," << result.opsPerSec
+            << "," << result.allocationsPerOp << "," << result.copiesPerOp << std::endl;
+    };
+
+    std::cout << "fifo,ops/s,allocations/op,copies/op" << std::endl;
+
+    // Copied in by push(T const&) and copy-assigned out by pop(T&)
+    print("Fifo4 copy", run<Fifo4<Message>>(iters, cpu1, cpu2,
+        [](auto& fifo, std::int64_t i) {
+            auto message = Message(i, text);
+            return fifo.push(message);
+        },
+        [](auto& fifo) {
+            auto message = Message{};
+            return fifo.pop(message) ? message.sequence : -1;
+        }));
+
+    // Moved in by push(T&&) and moved out by pop(T&)
+    print("Fifo5e move", run<Fifo5e<Message>>(iters, cpu1, cpu2,
+        [message = Message{}](auto& fifo, std::int64_t i) mutable {
+            if (message.text.empty()) {
+                message = Message(i, text);
+            }
+            message.sequence = i;
+            return fifo.push(std::move(message));
+        },
+        [](auto& fifo) {
+            auto message = Message{};
+            return fifo.pop(message) ? message.sequence : -1;
+        }));
+
+    // Constructed in place by emplace() and used in place via a popper
+    print("Fifo5e emplace", run<Fifo5e<Message>>(iters, cpu1, cpu2,
+        [](auto& fifo, std::int64_t i) {
+            return fifo.emplace(i, text);
+        },
+        [](auto& fifo) {
+            auto popper = fifo.pop();
+            return popper ? popper->sequence : -1;
+        }));
+
+    // Move-only; Fifo4 cannot hold these at all
+    print("Fifo5e unique_ptr", run<Fifo5e<std::unique_ptr<Message>>>(iters, cpu1, cpu2,
+        [message = std::unique_ptr<Message>{}](auto& fifo, std::int64_t i) mutable {
+            if (not message) {
+                message = std::make_unique<Message>(i, text);
+            }
+            message->sequence = i;
+            return fifo.push(std::move(message));
+        },
+        [](auto& fifo) {
+            auto popper = fifo.pop();
+            return popper ? (*popper)->sequence : -1;
+        }));
+}
@@ -0,0 +1,152 @@
+#include "MpmcFifo.hpp"
+#include "Mutex.hpp"
+#include "TryLock.hpp"
+#include "bench.hpp"
+#include "topology.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+
+/// Jain's fairness index of per-thread operation counts: 1 when every
+/// thread did the same amount of work, 1/n when one thread did all of it.
+inline double fairness(std::vector<long> const& counts) {
+    auto sum = 0.0;
+    auto sumOfSquares = 0.0;
+    for (auto count : counts) {
+        sum += double(count);
+        sumOfSquares += double(count) * double(count);
+    }
+    return sumOfSquares == 0 ? 1.0 : sum * sum / (double(counts.size()) * sumOfSquares);
+}
+
+/// Runs `producers` push threads and `consumers` pop threads for
+/// `duration`. Each value carries its producer's index in the high bits so
+/// every pop thread can check that each producer's values reach it in
+/// order.
+template<typename T>
+class MpmcBench
+{
+public:
+    using value_type = typename T::value_type;
+
+    static constexpr auto fifoSize = 131072;
+    static constexpr auto producerShift = 40;
+
+    struct Result
+    {
+        long opsPerSec;
+        double producerFairness;
+        double consumerFairness;
+    };
+
+    /// @param cpus CPUs to pin to, pop threads first; threads beyond the
+    /// end of `cpus` are not pinned
+    auto operator()(std::chrono::milliseconds duration, int producers, int consumers, std::vector<int> const& cpus) {
+        using namespace std::chrono_literals;
+
+        auto pushed = std::vector<long>(std::size_t(producers));
+        auto popped = std::vector<long>(std::size_t(consumers));
+        auto running = std::atomic<int>{};
+        auto stop = std::atomic<bool>{};
+        auto done = std::atomic<int>{};
+
+        auto threads = std::vector<std::jthread>{};
+        for (auto consumer = 0; consumer < consumers; ++consumer) {
+            threads.emplace_back([&, consumer] {
+                pinThread(topology::cpuFor(cpus, consumer));
+                auto last = std::vector<value_type>(std::size_t(producers), -1);
+                auto count = 0l;
+                running.fetch_add(1);
+                // Keep popping until the producers have stopped and the
+                // fifo is drained
+                while (done.load(std::memory_order_acquire) != producers || not q.empty()) {
+                    auto value = value_type{};
+                    if (not q.pop(value)) {
+                        continue;
+                    }
+                    auto producer = std::size_t(value >> producerShift);
+                    auto sequence = value & mask;
+                    if (producer >= last.size() || sequence <= last[producer]) {
+                        throw std::runtime_error("invalid value");
+                    }
+                    last[producer] = sequence;
+                    ++count;
+                }
+                popped[std::size_t(consumer)] = count;
+            });
+        }
+        for (auto producer = 0; producer < producers; ++producer) {
+            threads.emplace_back([&, producer] {
+                pinThread(topology::cpuFor(cpus, consumers + producer));
+                auto base = value_type{producer} << producerShift;
+                auto i = value_type{};
+                running.fetch_add(1);
+                while (not stop.load(std::memory_order_relaxed)) {
+                    if (q.push(base | i)) {
+                        ++i;
+                    }
+                }
+                pushed[std::size_t(producer)] = i;
+                done.fetch_add(1, std::memory_order_release);
+            });
+        }
+
+        while (running.load() != producers + consumers) {
+            std::this_thread::yield();
+        }
+        auto start = std::chrono::steady_clock::now();
+        std::this_thread::sleep_for(duration);
+        stop = true;
+        threads.clear();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+
+        auto total = std::accumulate(popped.begin(), popped.end(), 0l);
+        if (total != std::accumulate(pushed.begin(), pushed.end(), 0l)) {
+            throw std::runtime_error("lost values");
+        }
+        return Result{(total * 1s)/elapsed, fairness(pushed), fairness(popped)};
+    }
+
+private:
+    static constexpr auto mask = (value_type{1} << producerShift) - 1;
+
+    T q{fifoSize};
+};
+
+
+template<typename T>
+using padded_mpmc_fifo = MpmcFifo<T, std::allocator<T>, true>;
+
+template<template<typename> class FifoT>
+void once(char const* name, std::chrono::milliseconds duration, int producers, int consumers, std::vector<int> const& cpus) {
+    using value_type = std::int64_t;
+
+    auto result = MpmcBench<FifoT<value_type>>{}(duration, producers, consumers, cpus);
+    std::cout << producers << "," << consumers << "," << name << "," << result.opsPerSec
+        << std::fixed << std::setprecision(3)
+        << "," << result.producerFairness << "," << result.consumerFairness
+        << std::defaultfloat << std::endl;
+}
+
+int main() {
+    using namespace std::chrono_literals;
+    constexpr auto duration = 1000ms;
+
+    auto cpus = topology::cpuIds();
+
+    std::cout << "producers,consumers,fifo,ops/s,producer fairness,consumer fairness" << std::endl;
+    for (auto producers : {1, 2, 4, 8}) {
+        for (auto consumers : {1, 2, 4, 8}) {
+            once<MpmcFifo>("MpmcFifo", duration, producers, consumers, cpus);
+            once<padded_mpmc_fifo>("MpmcFifo padded", duration, producers, consumers, cpus);
+            once<Mutex>("Mutex", duration, producers, consumers, cpus);
+            once<TryLock>("TryLock", duration, producers, consumers, cpus);
+        }
+    }
+}
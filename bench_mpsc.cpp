@@ -0,0 +1,88 @@
+#include "MpscFifo.hpp"
+#include "Mutex.hpp"
+#include "TryLock.hpp"
+#include "bench.hpp"
+#include "topology.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+
+/// Throughput of `producers` push threads feeding one pop thread. Each
+/// value carries its producer's index in the high bits so the pop thread
+/// can check that every producer's values arrive in order.
+template<typename T>
+class MpscBench
+{
+public:
+    using value_type = typename T::value_type;
+
+    static constexpr auto fifoSize = 131072;
+    static constexpr auto maxProducers = 8;
+    static constexpr auto producerShift = 40;
+
+    /// @param cpus CPUs to pin to, pop thread first; threads beyond the
+    /// end of `cpus` are not pinned
+    auto operator()(long iters, int producers, std::vector<int> const& cpus) {
+        using namespace std::chrono_literals;
+
+        auto perProducer = iters / producers;
+        auto go = std::atomic<bool>{};
+
+        auto threads = std::vector<std::jthread>{};
+        for (auto producer = 0; producer < producers; ++producer) {
+            threads.emplace_back([&, producer] {
+                pinThread(topology::cpuFor(cpus, producer + 1));
+                while (not go.load(std::memory_order_acquire)) {
+                    ;
+                }
+                auto base = value_type{producer} << producerShift;
+                for (auto i = value_type{}; i < perProducer; ++i) {
+                    spinPush(q, base | i);
+                }
+            });
+        }
+
+        pinThread(topology::cpuFor(cpus, 0));
+        auto next = std::array<value_type, maxProducers>{};
+        auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (auto i = 0l; i < perProducer * producers; ++i) {
+            auto value = spinPop(q);
+            auto producer = std::size_t(value >> producerShift);
+            if (producer >= std::size_t(producers) || (value & mask) != next[producer]++) {
+                throw std::runtime_error("invalid value");
+            }
+        }
+        auto stop = std::chrono::steady_clock::now();
+
+        return (perProducer * producers * 1s)/(stop - start);
+    }
+
+private:
+    static constexpr auto mask = (value_type{1} << producerShift) - 1;
+
+    T q{fifoSize};
+};
+
+
+int main() {
+    constexpr auto iters = 20'000'000l;
+
+    auto cpus = topology::cpuIds();
+
+    using value_type = std::int64_t;
+
+    std::cout << "producers,MpscFifo,Mutex,TryLock" << std::endl;
+    for (auto producers = 1; producers <= MpscBench<MpscFifo<value_type>>::maxProducers; ++producers) {
+        std::cout << producers << "," << std::flush
+            << MpscBench<MpscFifo<value_type>>{}(iters, producers, cpus) << "," << std::flush
+            << MpscBench<Mutex<value_type>>{}(iters, producers, cpus) << "," << std::flush
+            << MpscBench<TryLock<value_type>>{}(iters, producers, cpus) << std::endl;
+    }
+}
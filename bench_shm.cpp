@@ -0,0 +1,101 @@
+#include "Fifo5a.hpp"
+#include "ShmFifo.hpp"
+#include "bench.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+constexpr auto fifoSize = 131072;
+
+/// Moves `iters` elements from this process, pinned to cpu2, to a forked
+/// child process, pinned to cpu1, through a ShmFifo that the child attaches
+/// to by name.
+/// @return elements per second
+template<typename ValueT>
+long crossProcess(long iters, int cpu1, int cpu2) {
+    using namespace std::chrono_literals;
+
+    auto name = "/cppcon2023-shmfifo-" + std::to_string(::getpid());
+    auto fifo = ShmFifo<ValueT>::create(name.c_str(), fifoSize);
+
+    auto child = ::fork();
+    if (child == -1) {
+        ShmFifo<ValueT>::unlink(name.c_str());
+        throw std::system_error(errno, std::generic_category(), "fork");
+    }
+    if (child == 0) {
+        auto status = EXIT_SUCCESS;
+        try {
+            auto q = ShmFifo<ValueT>::attach(name.c_str());
+            pinThread(cpu1);
+            for (auto i = ValueT{}; i < fifoSize + iters; ++i) {
+                auto expected = i < fifoSize ? i : i - fifoSize;
+                if (spinPop(q) != expected) {
+                    std::cerr << "invalid value" << std::endl;
+                    status = EXIT_FAILURE;
+                    break;
+                }
+            }
+        } catch (std::exception const& e) {
+            std::cerr << e.what() << std::endl;
+            status = EXIT_FAILURE;
+        }
+        // Skip the parent's atexit handlers and stdio buffers
+        std::_Exit(status);
+    }
+
+    pinThread(cpu2);
+
+    // push warmup
+    for (auto i = ValueT{}; i < fifoSize; ++i) {
+        spinPush(fifo, i);
+    }
+    while (auto again = not fifo.empty()) {
+        doNotOptimize(again);
+    }
+
+    // push benchmark run
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = ValueT{}; i < iters; ++i) {
+        spinPush(fifo, i);
+    }
+    while (auto again = not fifo.empty()) {
+        doNotOptimize(again);
+    }
+    auto stop = std::chrono::steady_clock::now();
+
+    auto status = 0;
+    ::waitpid(child, &status, 0);
+    ShmFifo<ValueT>::unlink(name.c_str());
+    if (not WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+        throw std::runtime_error("pop process failed");
+    }
+
+    return (iters * 1s)/(stop - start);
+}
+
+int main(int argc, char* argv[]) {
+    int cpu1 = 1;
+    int cpu2 = 2;
+    if (argc == 3) {
+       cpu1 = std::atoi(argv[1]);
+       cpu2 = std::atoi(argv[2]);
+    }
+
+    constexpr auto iters = 400'000'000l;
+
+    using value_type = std::int64_t;
+
+    std::cout << std::setw(17) << std::left << "Fifo5a threads" << ": "
+        << std::setw(10) << std::right << bench<Fifo5a<value_type>>("Fifo5a", iters, cpu1, cpu2) << " ops/s" << std::endl;
+    std::cout << std::setw(17) << std::left << "ShmFifo processes" << ": "
+        << std::setw(10) << std::right << crossProcess<value_type>(iters, cpu1, cpu2) << " ops/s" << std::endl;
+}
@@ -0,0 +1,145 @@
+#include "Fifo5a.hpp"
+#include "SpmcFifo.hpp"
+#include "bench.hpp"
+#include "topology.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+
+constexpr auto fifoSize = 131072;
+
+struct Result
+{
+    long opsPerSec;
+    LogHistogram<> latency;  ///< push to pop, rdtsc() ticks
+};
+
+using Task = StampedValue<>;
+
+/// Hands `iters` tasks from one push thread to `consumers` pop threads
+/// through one SpmcFifo; each task goes to whichever pop thread claims it.
+/// @param cpus CPUs to pin to, push thread first; threads beyond the end of
+/// `cpus` are not pinned
+inline Result shared(long iters, int consumers, std::vector<int> const& cpus) {
+    using namespace std::chrono_literals;
+
+    auto fifo = SpmcFifo<Task>(fifoSize);
+    auto histograms = std::vector<LogHistogram<>>(std::size_t(consumers));
+    auto done = std::atomic<bool>{};
+
+    auto threads = std::vector<std::jthread>{};
+    for (auto consumer = 0; consumer < consumers; ++consumer) {
+        threads.emplace_back([&, consumer] {
+            pinThread(topology::cpuFor(cpus, consumer + 1));
+            auto& histogram = histograms[std::size_t(consumer)];
+            auto last = std::int64_t{-1};
+            while (not done.load(std::memory_order_acquire) || not fifo.empty()) {
+                auto task = Task{};
+                if (not fifo.pop(task)) {
+                    continue;
+                }
+                auto now = rdtsc();
+                if (task.sequence <= last) {
+                    throw std::runtime_error("invalid value");
+                }
+                last = task.sequence;
+                histogram.record(now - std::min(now, task.tsc));
+            }
+        });
+    }
+
+    pinThread(topology::cpuFor(cpus, 0));
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = std::int64_t{}; i < iters; ++i) {
+        auto task = Task{};
+        task.sequence = i;
+        task.tsc = rdtsc();
+        spinPush(fifo, task);
+    }
+    done.store(true, std::memory_order_release);
+    threads.clear();
+    auto stop = std::chrono::steady_clock::now();
+
+    auto result = Result{(iters * 1s)/(stop - start), {}};
+    for (auto const& histogram : histograms) {
+        result.latency.merge(histogram);
+    }
+    if (result.latency.count() != std::uint64_t(iters)) {
+        throw std::runtime_error("lost values");
+    }
+    return result;
+}
+
+/// Hands `iters` tasks from one push thread to `consumers` pop threads
+/// round-robin over a separate Fifo5a per pop thread.
+/// @param cpus as for shared()
+inline Result roundRobin(long iters, int consumers, std::vector<int> const& cpus) {
+    using namespace std::chrono_literals;
+
+    auto fifos = std::vector<std::unique_ptr<Fifo5a<Task>>>{};
+    for (auto consumer = 0; consumer < consumers; ++consumer) {
+        fifos.push_back(std::make_unique<Fifo5a<Task>>(fifoSize));
+    }
+    auto histograms = std::vector<LogHistogram<>>(std::size_t(consumers));
+
+    auto threads = std::vector<std::jthread>{};
+    for (auto consumer = 0; consumer < consumers; ++consumer) {
+        threads.emplace_back([&, consumer] {
+            pinThread(topology::cpuFor(cpus, consumer + 1));
+            auto& fifo = *fifos[std::size_t(consumer)];
+            auto& histogram = histograms[std::size_t(consumer)];
+            for (auto i = std::int64_t{consumer}; i < iters; i += consumers) {
+                auto task = spinPop(fifo);
+                auto now = rdtsc();
+                if (task.sequence != i) {
+                    throw std::runtime_error("invalid value");
+                }
+                histogram.record(now - std::min(now, task.tsc));
+            }
+        });
+    }
+
+    pinThread(topology::cpuFor(cpus, 0));
+    auto start = std::chrono::steady_clock::now();
+    for (auto i = std::int64_t{}; i < iters; ++i) {
+        auto task = Task{};
+        task.sequence = i;
+        task.tsc = rdtsc();
+        spinPush(*fifos[std::size_t(i % consumers)], task);
+    }
+    threads.clear();
+    auto stop = std::chrono::steady_clock::now();
+
+    auto result = Result{(iters * 1s)/(stop - start), {}};
+    for (auto const& histogram : histograms) {
+        result.latency.merge(histogram);
+    }
+    return result;
+}
+
+inline void print(int consumers, char const* name, Result const& result) {
+    std::cout << consumers << "," << name << "," << result.opsPerSec << std::fixed << std::setprecision(1)
+        << "," << tscToNanoseconds(result.latency.percentile(50))
+        << "," << tscToNanoseconds(result.latency.percentile(99))
+        << "," << tscToNanoseconds(result.latency.percentile(99.9))
+        << "," << tscToNanoseconds(result.latency.max()) << std::defaultfloat << std::endl;
+}
+
+int main() {
+    constexpr auto iters = 20'000'000l;
+    constexpr auto maxConsumers = 8;
+
+    auto cpus = topology::cpuIds();
+
+    std::cout << "consumers,fifo,ops/s,p50 ns,p99 ns,p99.9 ns,max ns" << std::endl;
+    for (auto consumers = 1; consumers <= maxConsumers; ++consumers) {
+        print(consumers, "SpmcFifo", shared(iters, consumers, cpus));
+        print(consumers, "Fifo5a round-robin", roundRobin(iters, consumers, cpus));
+    }
+}
@@ -0,0 +1,129 @@
+#include "Fifo5.hpp"
+#include "Fifo5a.hpp"
+#include "Fifo5b.hpp"
+#include "bench.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+
+/// Measures, for a mostly idle fifo, how long the pop thread takes to see a
+/// newly pushed element and how much CPU it burns while waiting. The push
+/// thread pushes its steady_clock time every `interval`. If Park the pop
+/// thread uses popWait(); otherwise it spins on pop().
+template<typename T, bool Park>
+class WaitBench
+{
+public:
+    using value_type = typename T::value_type;
+
+    static constexpr auto fifoSize = 1024;
+
+    struct Result
+    {
+        std::chrono::nanoseconds p50;
+        std::chrono::nanoseconds p99;
+        std::chrono::nanoseconds max;
+        double cpuPercent;
+    };
+
+    auto operator()(long count, std::chrono::microseconds interval, int cpu1, int cpu2) {
+        auto latencies = std::vector<std::chrono::nanoseconds>(static_cast<std::size_t>(count));
+        auto cpuPercent = 0.0;
+
+        auto t = std::jthread([&] {
+            pinThread(cpu1);
+            auto cpuStart = threadCpuTime();
+            auto wallStart = std::chrono::steady_clock::now();
+            for (auto& latency : latencies) {
+                auto value = value_type{};
+                if constexpr(Park) {
+                    q.popWait(value);
+                } else {
+                    while (auto again = not q.pop(value)) {
+                        doNotOptimize(again);
+                    }
+                }
+                latency = now() - std::chrono::nanoseconds(value);
+            }
+            auto wall = std::chrono::steady_clock::now() - wallStart;
+            cpuPercent = 100.0 * double((threadCpuTime() - cpuStart).count()) / double(wall.count());
+        });
+
+        pinThread(cpu2);
+        auto next = std::chrono::steady_clock::now();
+        for (auto i = 0l; i < count; ++i) {
+            next += interval;
+            std::this_thread::sleep_until(next);
+            q.push(now().count());
+        }
+        t.join();
+
+        std::sort(latencies.begin(), latencies.end());
+        return Result{
+            latencies[latencies.size()/2],
+            latencies[latencies.size()*99/100],
+            latencies.back(),
+            cpuPercent};
+    }
+
+private:
+    static std::chrono::nanoseconds now() {
+        return std::chrono::steady_clock::now().time_since_epoch();
+    }
+
+    static std::chrono::nanoseconds threadCpuTime() {
+        ::timespec ts;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+    }
+
+private:
+    T q{fifoSize};
+};
+
+
+// popWait() needs the FutexWait policy
+template<typename T>
+using blocking_fifo5 = Fifo5<T, std::allocator<T>, NoStats, Padded64Layout, FutexWait>;
+template<typename T>
+using blocking_fifo5a = Fifo5a<T, std::allocator<T>, Padded64Layout, FutexWait>;
+template<typename T>
+using blocking_fifo5b = Fifo5b<T, std::allocator<T>, Padded64Layout, FutexWait>;
+
+
+template<template<typename> class FifoT, bool Park>
+void once(char const* name, long count, std::chrono::microseconds interval, int cpu1, int cpu2) {
+    using value_type = std::int64_t;
+
+    auto result = WaitBench<FifoT<value_type>, Park>{}(count, interval, cpu1, cpu2);
+    std::cout << std::setw(6) << std::left << name << (Park ? " park" : " spin") << ": "
+        << "p50 " << std::setw(7) << std::right << result.p50.count() << " ns, "
+        << "p99 " << std::setw(7) << std::right << result.p99.count() << " ns, "
+        << "max " << std::setw(9) << std::right << result.max.count() << " ns, "
+        << "cpu " << std::setw(5) << std::right << std::fixed << std::setprecision(1)
+        << result.cpuPercent << "%\n";
+}
+
+int main(int argc, char* argv[]) {
+    int cpu1 = 1;
+    int cpu2 = 2;
+    if (argc == 3) {
+       cpu1 = std::atoi(argv[1]);
+       cpu2 = std::atoi(argv[2]);
+    }
+
+    using namespace std::chrono_literals;
+    constexpr auto count = 10'000l;
+    constexpr auto interval = 100us;
+
+    once<blocking_fifo5, false>("Fifo5", count, interval, cpu1, cpu2);
+    once<blocking_fifo5, true>("Fifo5", count, interval, cpu1, cpu2);
+    once<blocking_fifo5a, false>("Fifo5a", count, interval, cpu1, cpu2);
+    once<blocking_fifo5a, true>("Fifo5a", count, interval, cpu1, cpu2);
+    once<blocking_fifo5b, false>("Fifo5b", count, interval, cpu1, cpu2);
+    once<blocking_fifo5b, true>("Fifo5b", count, interval, cpu1, cpu2);
+}
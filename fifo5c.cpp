@@ -0,0 +1,10 @@
+#include "Fifo5c.hpp"
+#include "bench.hpp"
+
+// Configuring capacity to match Bench's fifoSize
+template<typename T>
+using fixed_fifo5c = Fifo5c<T, 131072>;
+
+int main(int argc, char* argv[]) {
+    bench<fixed_fifo5c>("Fifo5c", argc, argv);
+}
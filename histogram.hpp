@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+
+/// HDR-style histogram of non-negative integers. Values are grouped into
+/// power of two buckets and each bucket is split into 2^SubBucketBits
+/// linear sub-buckets, so recorded values keep a relative precision of
+/// 2^-SubBucketBits over the whole 64 bit range in a fixed 15 KB table.
+template<unsigned SubBucketBits = 5>
+class LogHistogram
+{
+public:
+    /// Record one value
+    void record(std::uint64_t value) noexcept {
+        ++counts_[index(value)];
+        ++count_;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    /// Add all of `other`'s values to this histogram
+    void merge(LogHistogram const& other) noexcept {
+        for (auto i = std::size_t{}; i < counts_.size(); ++i) {
+            counts_[i] += other.counts_[i];
+        }
+        count_ += other.count_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+    /// Returns the number of values recorded
+    auto count() const noexcept { return count_; }
+
+    /// Returns the smallest value recorded, or 0 if there are none
+    auto min() const noexcept { return count_ ? min_ : 0; }
+
+    /// Returns the largest value recorded
+    auto max() const noexcept { return max_; }
+
+    /// Returns the value at or below which `percent` of the recorded
+    /// values fall. The value is the top of its sub-bucket, clamped to
+    /// max(), so it never understates.
+    std::uint64_t percentile(double percent) const noexcept {
+        if (count_ == 0) {
+            return 0;
+        }
+        auto rank = static_cast<std::uint64_t>(std::ceil(percent / 100.0 * double(count_)));
+        rank = std::clamp(rank, std::uint64_t{1}, count_);
+
+        auto seen = std::uint64_t{};
+        for (auto i = std::size_t{}; i < counts_.size(); ++i) {
+            seen += counts_[i];
+            if (seen >= rank) {
+                return std::min(highestEquivalent(i), max_);
+            }
+        }
+        return max_;
+    }
+
+private:
+    static constexpr auto subBuckets = std::uint64_t{1} << SubBucketBits;
+
+    static std::size_t index(std::uint64_t value) noexcept {
+        if (value < subBuckets) {
+            return value;
+        }
+        auto shift = static_cast<unsigned>(std::bit_width(value)) - 1 - SubBucketBits;
+        return (shift + 1) * subBuckets + ((value >> shift) - subBuckets);
+    }
+
+    static std::uint64_t highestEquivalent(std::size_t index) noexcept {
+        if (index < subBuckets) {
+            return index;
+        }
+        auto shift = index / subBuckets - 1;
+        auto subBucket = index % subBuckets;
+        return ((subBuckets + subBucket + 1) << shift) - 1;
+    }
+
+private:
+    std::array<std::uint64_t, (64 - SubBucketBits + 1) * subBuckets> counts_{};
+    std::uint64_t count_{};
+    std::uint64_t min_{std::numeric_limits<std::uint64_t>::max()};
+    std::uint64_t max_{};
+};
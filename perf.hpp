@@ -0,0 +1,155 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+/// Per-thread hardware performance counters via perf_event_open(2). Events
+/// that cannot be opened, because the PMU lacks them or because of
+/// perf_event_paranoid or a container, are skipped and read back as empty.
+namespace perf {
+
+enum Event { cycles, instructions, l1dMisses, llcMisses, hitm, eventCount };
+
+inline char const* name(Event event) noexcept {
+    switch (event) {
+        case cycles: return "cycles";
+        case instructions: return "instructions";
+        case l1dMisses: return "L1D misses";
+        case llcMisses: return "LLC misses";
+        case hitm: return "HITM";
+        case eventCount: break;
+    }
+    return "?";
+}
+
+/// Counter values; empty where the event was not available
+using Counts = std::array<std::optional<std::uint64_t>, eventCount>;
+
+/// Counts user space events on the thread that constructs it
+class Counters
+{
+public:
+    Counters() noexcept {
+        for (auto event = 0; event < eventCount; ++event) {
+            fds_[event] = open(static_cast<Event>(event));
+        }
+    }
+
+    Counters(Counters const&) = delete;
+    Counters& operator=(Counters const&) = delete;
+
+    ~Counters() {
+        for (auto fd : fds_) {
+            if (fd != -1) {
+                ::close(fd);
+            }
+        }
+    }
+
+    /// Returns whether any event could be opened
+    bool available() const noexcept {
+        for (auto fd : fds_) {
+            if (fd != -1) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Zero and enable the counters
+    void start() noexcept {
+        for (auto fd : fds_) {
+            if (fd != -1) {
+                ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+    }
+
+    void stop() noexcept {
+        for (auto fd : fds_) {
+            if (fd != -1) {
+                ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+    }
+
+    /// Returns the counts since start(), scaled up if the kernel had to
+    /// multiplex the counters
+    Counts read() const noexcept {
+        auto counts = Counts{};
+        for (auto event = 0; event < eventCount; ++event) {
+            struct { std::uint64_t value, enabled, running; } data;
+            auto fd = fds_[event];
+            if (fd != -1 && ::read(fd, &data, sizeof(data)) == sizeof(data) && data.running != 0) {
+                counts[event] = data.running == data.enabled
+                    ? data.value
+                    : static_cast<std::uint64_t>(double(data.value) * double(data.enabled) / double(data.running));
+            }
+        }
+        return counts;
+    }
+
+private:
+    static int open(Event event) noexcept {
+        auto attr = ::perf_event_attr{};
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        switch (event) {
+            case cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case l1dMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D
+                    | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            case llcMisses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            case hitm:
+                // Cross-core modified line hits have no generic event; the
+                // raw encoding is model specific so it must be supplied,
+                // e.g. BENCH_PERF_HITM=0x04d2 on Skylake for
+                // MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM
+                if (auto raw = std::getenv("BENCH_PERF_HITM"); raw) {
+                    attr.type = PERF_TYPE_RAW;
+                    attr.config = std::strtoull(raw, nullptr, 0);
+                } else {
+                    return -1;
+                }
+                break;
+            case eventCount:
+                return -1;
+        }
+
+        auto fd = ::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        return static_cast<int>(fd);
+    }
+
+private:
+    std::array<int, eventCount> fds_;
+};
+
+}  // namespace perf
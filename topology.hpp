@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+
+/// CPU topology from /sys/devices/system/cpu, used to choose core pairs
+/// that share progressively less of the cache hierarchy.
+namespace topology {
+
+/// What two CPUs have in common, closest first; unknown if either's
+/// package is, as in many containers and VMs
+enum class Sharing { smt, l2, l3, package, none, unknown };
+
+inline char const* name(Sharing sharing) noexcept {
+    switch (sharing) {
+        case Sharing::smt: return "SMT";
+        case Sharing::l2: return "L2";
+        case Sharing::l3: return "L3";
+        case Sharing::package: return "package";
+        case Sharing::none: return "cross-package";
+        case Sharing::unknown: return "unknown";
+    }
+    return "?";
+}
+
+/// Where a CPU sits. Each cache is identified by the lowest numbered CPU
+/// sharing it; -1 if unknown.
+struct Cpu
+{
+    int id;
+    int core = -1;
+    int package = -1;
+    int l2 = -1;
+    int l3 = -1;
+    int node = -1;  ///< NUMA node
+};
+
+struct CpuPair
+{
+    Sharing sharing;
+    int cpu1;
+    int cpu2;
+};
+
+namespace detail {
+
+inline std::optional<std::string> readFile(std::string const& path) {
+    auto file = std::ifstream(path);
+    auto contents = std::string{};
+    if (not std::getline(file, contents)) {
+        return {};
+    }
+    return contents;
+}
+
+inline int readInt(std::string const& path) {
+    auto contents = readFile(path);
+    return contents ? std::stoi(*contents) : -1;
+}
+
+/// Parse a cpu list such as "0-3,8,10-11", ignoring a trailing newline
+inline std::vector<int> parseList(std::string list) {
+    while (not list.empty() && std::isspace(static_cast<unsigned char>(list.back()))) {
+        list.pop_back();
+    }
+    auto cpus = std::vector<int>{};
+    auto stream = std::istringstream(list);
+    for (auto range = std::string{}; std::getline(stream, range, ',');) {
+        if (range.empty()) {
+            continue;
+        }
+        auto dash = range.find('-');
+        auto first = std::stoi(range.substr(0, dash));
+        auto last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (auto cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/// Returns the lowest numbered CPU sharing `cpu`'s cache of `level`
+inline int cacheId(int cpu, int level) {
+    auto base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cache/index";
+    for (auto index = 0;; ++index) {
+        auto dir = base + std::to_string(index);
+        auto indexLevel = readInt(dir + "/level");
+        if (indexLevel == -1) {
+            return -1;
+        }
+        auto type = readFile(dir + "/type");
+        if (indexLevel == level && type && *type != "Instruction") {
+            auto shared = readFile(dir + "/shared_cpu_list");
+            auto cpus = shared ? parseList(*shared) : std::vector<int>{};
+            return cpus.empty() ? -1 : *std::min_element(cpus.begin(), cpus.end());
+        }
+    }
+}
+
+/// Returns the NUMA node of each CPU, indexed by CPU; -1 if unknown
+inline std::vector<int> nodes() {
+    auto result = std::vector<int>{};
+    auto online = readFile("/sys/devices/system/node/online");
+    for (auto node : online ? parseList(*online) : std::vector<int>{}) {
+        auto list = readFile("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        for (auto cpu : list ? parseList(*list) : std::vector<int>{}) {
+            if (std::size_t(cpu) >= result.size()) {
+                result.resize(std::size_t(cpu) + 1, -1);
+            }
+            result[std::size_t(cpu)] = node;
+        }
+    }
+    return result;
+}
+
+}  // namespace detail
+
+/// Returns the online CPUs this process may run on
+inline std::vector<Cpu> cpus() {
+    auto online = detail::readFile("/sys/devices/system/cpu/online");
+    auto ids = online ? detail::parseList(*online) : std::vector<int>{};
+
+    ::cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    auto haveAffinity = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    auto nodes = detail::nodes();
+
+    auto result = std::vector<Cpu>{};
+    for (auto id : ids) {
+        if (haveAffinity && not CPU_ISSET(id, &allowed)) {
+            continue;
+        }
+        auto base = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+        result.push_back(Cpu{
+            id,
+            detail::readInt(base + "core_id"),
+            detail::readInt(base + "physical_package_id"),
+            detail::cacheId(id, 2),
+            detail::cacheId(id, 3),
+            std::size_t(id) < nodes.size() ? nodes[std::size_t(id)] : -1});
+    }
+    return result;
+}
+
+/// Returns the ids of cpus()
+inline std::vector<int> cpuIds() {
+    auto result = std::vector<int>{};
+    for (auto const& cpu : cpus()) {
+        result.push_back(cpu.id);
+    }
+    return result;
+}
+
+/// Returns the CPU to pin `thread` to, `ids[thread]`, or -1, which
+/// pinThread() ignores, for threads beyond the end of `ids`
+inline int cpuFor(std::vector<int> const& ids, int thread) noexcept {
+    return thread < int(ids.size()) ? ids[std::size_t(thread)] : -1;
+}
+
+/// Returns the closest level of the hierarchy `a` and `b` share
+inline Sharing sharing(Cpu const& a, Cpu const& b) noexcept {
+    auto same = [](int x, int y) { return x != -1 && x == y; };
+    if (a.package == -1 || b.package == -1) {
+        return Sharing::unknown;
+    }
+    if (not same(a.package, b.package)) {
+        return Sharing::none;
+    }
+    if (same(a.core, b.core)) {
+        return Sharing::smt;
+    }
+    if (same(a.l2, b.l2)) {
+        return Sharing::l2;
+    }
+    if (same(a.l3, b.l3)) {
+        return Sharing::l3;
+    }
+    return Sharing::package;
+}
+
+/// Returns one pair of CPUs for each level of sharing present, closest
+/// first. Prefers the lowest numbered pair at each level and skips pairs
+/// whose sharing is unknown.
+inline std::vector<CpuPair> representativePairs(std::vector<Cpu> const& cpus = topology::cpus()) {
+    auto result = std::vector<CpuPair>{};
+    for (auto i = std::size_t{}; i < cpus.size(); ++i) {
+        for (auto j = i + 1; j < cpus.size(); ++j) {
+            auto level = sharing(cpus[i], cpus[j]);
+            if (level == Sharing::unknown) {
+                continue;
+            }
+            auto found = std::find_if(result.begin(), result.end(),
+                [&](auto const& pair) { return pair.sharing == level; });
+            if (found == result.end()) {
+                result.push_back(CpuPair{level, cpus[i].id, cpus[j].id});
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(),
+        [](auto const& a, auto const& b) { return a.sharing < b.sharing; });
+    return result;
+}
+
+/// Returns a pair of CPUs on the same NUMA node followed by a pair on
+/// different nodes, each if present. Prefers pairs that do not share a
+/// core so that SMT does not flatter the same-node result.
+inline std::vector<CpuPair> nodePairs(std::vector<Cpu> const& cpus = topology::cpus()) {
+    auto result = std::vector<CpuPair>{};
+    auto find = [&](bool sameNode) -> std::optional<CpuPair> {
+        auto best = std::optional<CpuPair>{};
+        for (auto i = std::size_t{}; i < cpus.size(); ++i) {
+            for (auto j = i + 1; j < cpus.size(); ++j) {
+                if (cpus[i].node == -1 || cpus[j].node == -1 || (cpus[i].node == cpus[j].node) != sameNode) {
+                    continue;
+                }
+                auto pair = CpuPair{sharing(cpus[i], cpus[j]), cpus[i].id, cpus[j].id};
+                if (pair.sharing != Sharing::smt) {
+                    return pair;
+                }
+                if (not best) {
+                    best = pair;
+                }
+            }
+        }
+        return best;
+    };
+    for (auto sameNode : {true, false}) {
+        if (auto pair = find(sameNode); pair) {
+            result.push_back(*pair);
+        }
+    }
+    return result;
+}
+
+}  // namespace topology
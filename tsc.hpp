@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+
+/// Read the time stamp counter. The fences keep the read from being
+/// reordered with the code being timed. Falls back to steady_clock
+/// nanoseconds where there is no TSC.
+inline std::uint64_t rdtsc() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_lfence();
+    auto tsc = __rdtsc();
+    _mm_lfence();
+    return tsc;
+#else
+    return static_cast<std::uint64_t>(std::chrono::nanoseconds(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/// Returns the nanoseconds per rdtsc() tick. Calibrated against
+/// steady_clock the first time it is called.
+inline double tscNanosecondsPerTick() {
+    static auto const nanosecondsPerTick = [] {
+        using namespace std::chrono_literals;
+
+        auto start = std::chrono::steady_clock::now();
+        auto tscStart = rdtsc();
+        std::this_thread::sleep_for(100ms);
+        auto stop = std::chrono::steady_clock::now();
+        auto tscStop = rdtsc();
+
+        auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+        return double(nanoseconds.count()) / double(tscStop - tscStart);
+    }();
+    return nanosecondsPerTick;
+}
+
+/// Convert a number of rdtsc() ticks to nanoseconds
+inline double tscToNanoseconds(std::uint64_t ticks) {
+    return double(ticks) * tscNanosecondsPerTick();
+}
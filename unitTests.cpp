@@ -1,14 +1,46 @@
+#include "AlignedAllocator.hpp"
+#include "BQueue.hpp"
+#include "BroadcastFifo.hpp"
+#include "ByteFifo.hpp"
+#include "FastForwardFifo.hpp"
+#include "Fifo.hpp"
 #include "Fifo1.hpp"
 #include "Fifo2.hpp"
 #include "Fifo3.hpp"
 #include "Fifo4.hpp"
+#include "Fifo4a.hpp"
 #include "Fifo5.hpp"
 #include "Fifo5a.hpp"
 #include "Fifo5b.hpp"
+#include "Fifo5c.hpp"
+#include "Fifo5d.hpp"
+#include "Fifo5e.hpp"
+#include "HugePageAllocator.hpp"
+#include "MpmcFifo.hpp"
+#include "MpscFifo.hpp"
+#include "NumaAllocator.hpp"
+#include "ShmFifo.hpp"
+#include "SpmcFifo.hpp"
+#include "UnboundedFifo.hpp"
+#include "topology.hpp"
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
 #include <type_traits>
+#include <vector>
 
 
 extern "C" {
@@ -33,6 +65,12 @@ public:
     FifoType fifo{4};
 };
 
+/// Fifo5c embeds its ring, so it is built without an allocator and only
+/// with a capacity equal to its `Capacity`; the fixture's 4 fits
+template<typename FifoT> constexpr bool embedsRing = false;
+template<typename T, std::size_t Capacity, typename Wait>
+constexpr bool embedsRing<Fifo5c<T, Capacity, Wait>> = true;
+
 using test_type = unsigned int;
 
 
@@ -42,15 +80,31 @@ using FifoTypes = ::testing::Types<
     Fifo2<test_type>,
     Fifo3<test_type>,
     Fifo4<test_type>,
+    Fifo4<test_type, std::allocator<test_type>, NoStats, CompactLayout>,
     Fifo5<test_type>,
-    Fifo5b<test_type>
+    Fifo5b<test_type>,
+    Fifo5b<test_type, std::allocator<test_type>, Padded128Layout>,
+    Fifo5c<test_type, 4>,
+    Fifo5d<test_type>,
+    Fifo5e<test_type>,
+    Fifo<test_type>,
+    Fifo<test_type, std::allocator<test_type>, ModuloIndex, AtomicRefCursor, false, SeqCstOrder>,
+    Fifo<test_type, std::allocator<test_type>, ConstrainedIndex, AtomicRefCursor, true, AcquireReleaseOrder, CompactLayout>,
+    FastForwardFifo<test_type>,
+    BQueue<test_type>,
+    BQueue<test_type, std::allocator<test_type>, 2>,
+    MpscFifo<test_type>,
+    MpmcFifo<test_type>,
+    MpmcFifo<test_type, std::allocator<test_type>, true>,
+    SpmcFifo<test_type>
     >;
 TYPED_TEST_SUITE(FifoTest, FifoTypes);
 
 TYPED_TEST(FifoTest, properties) {
     EXPECT_FALSE(std::is_default_constructible_v<typename TestFixture::FifoType>);
     EXPECT_TRUE((std::is_constructible_v<typename TestFixture::FifoType, unsigned long>));
-    EXPECT_TRUE((std::is_constructible_v<typename TestFixture::FifoType, unsigned long, std::allocator<typename TestFixture::value_type>>));
+    EXPECT_EQ(!embedsRing<typename TestFixture::FifoType>,
+        (std::is_constructible_v<typename TestFixture::FifoType, unsigned long, std::allocator<typename TestFixture::value_type>>));
     EXPECT_FALSE(std::is_copy_constructible_v<typename TestFixture::FifoType>);
     EXPECT_FALSE(std::is_move_constructible_v<typename TestFixture::FifoType>);
     EXPECT_FALSE(std::is_copy_assignable_v<typename TestFixture::FifoType>);
@@ -165,7 +219,15 @@ TYPED_TEST(FifoTest, wrap) {
 
 template<typename FifoT> using ProxyTest = FifoTestBase<FifoT>;
 using ProxyFifoTypes = ::testing::Types<
-    Fifo5<test_type>
+    Fifo5<test_type>,
+    Fifo5c<test_type, 4>,
+    Fifo5d<test_type>,
+    Fifo5e<test_type>,
+    Fifo<test_type>,
+    Fifo<test_type, std::allocator<test_type>, ConstrainedIndex, AtomicRefCursor>,
+    FastForwardFifo<test_type>,
+    BQueue<test_type>,
+    MpscFifo<test_type>
     >;
 TYPED_TEST_SUITE(ProxyTest, ProxyFifoTypes);
 
@@ -236,6 +298,1240 @@ TYPED_TEST(ProxyTest, popperRelease) {
 }
 
 
+template<typename FifoT> using BulkTest = FifoTestBase<FifoT>;
+using BulkFifoTypes = ::testing::Types<
+    Fifo5<test_type>,
+    Fifo5a<test_type>,
+    Fifo5c<test_type, 4>
+    >;
+TYPED_TEST_SUITE(BulkTest, BulkFifoTypes);
+
+TYPED_TEST(BulkTest, pushSpan) {
+    auto values = std::array<test_type, 5>{42, 43, 44, 45, 46};
+    EXPECT_TRUE(this->fifo.push(std::span<test_type const>{}));
+    EXPECT_TRUE(this->fifo.empty());
+
+    // all or nothing
+    EXPECT_FALSE(this->fifo.push(std::span<test_type const>(values)));
+    EXPECT_TRUE(this->fifo.empty());
+
+    EXPECT_TRUE(this->fifo.push(std::span<test_type const>(values).first(3)));
+    EXPECT_EQ(3u, this->fifo.size());
+    EXPECT_FALSE(this->fifo.push(std::span<test_type const>(values).first(2)));
+    EXPECT_EQ(3u, this->fifo.size());
+
+    for (auto i = 0u; i < 3u; ++i) {
+        auto value = test_type{};
+        EXPECT_TRUE(this->fifo.pop(value));
+        EXPECT_EQ(42 + i, value);
+    }
+}
+
+TYPED_TEST(BulkTest, pushUpTo) {
+    auto values = std::array<test_type, 5>{42, 43, 44, 45, 46};
+    EXPECT_EQ(0u, this->fifo.pushUpTo({}));
+
+    EXPECT_EQ(3u, this->fifo.pushUpTo(std::span<test_type const>(values).first(3)));
+    EXPECT_EQ(1u, this->fifo.pushUpTo(std::span<test_type const>(values).subspan(3)));
+    EXPECT_TRUE(this->fifo.full());
+    EXPECT_EQ(0u, this->fifo.pushUpTo(values));
+
+    for (auto i = 0u; i < 4u; ++i) {
+        auto value = test_type{};
+        EXPECT_TRUE(this->fifo.pop(value));
+        EXPECT_EQ(42 + i, value);
+    }
+}
+
+TYPED_TEST(BulkTest, popSpan) {
+    auto values = std::array<test_type, 5>{};
+    EXPECT_TRUE(this->fifo.pop(std::span<test_type>{}));
+    EXPECT_FALSE(this->fifo.pop(std::span(values).first(1)));
+
+    for (auto i = 0u; i < 3u; ++i) {
+        this->fifo.push(42 + i);
+    }
+
+    // all or nothing
+    EXPECT_FALSE(this->fifo.pop(std::span(values).first(4)));
+    EXPECT_EQ(3u, this->fifo.size());
+
+    EXPECT_TRUE(this->fifo.pop(std::span(values).first(2)));
+    EXPECT_EQ(1u, this->fifo.size());
+    EXPECT_EQ(42u, values[0]);
+    EXPECT_EQ(43u, values[1]);
+}
+
+TYPED_TEST(BulkTest, popUpTo) {
+    auto values = std::array<test_type, 5>{};
+    EXPECT_EQ(0u, this->fifo.popUpTo(values));
+
+    for (auto i = 0u; i < 3u; ++i) {
+        this->fifo.push(42 + i);
+    }
+    EXPECT_EQ(3u, this->fifo.popUpTo(values));
+    EXPECT_TRUE(this->fifo.empty());
+    for (auto i = 0u; i < 3u; ++i) {
+        EXPECT_EQ(42 + i, values[i]);
+    }
+}
+
+TYPED_TEST(BulkTest, wrap) {
+    auto values = std::array<test_type, 4>{};
+    for (auto i = 0u; i < this->fifo.capacity() * 2 + 1; ++i) {
+        auto first = test_type(42 + 3*i);
+        auto in = std::array<test_type, 3>{first, first + 1, first + 2};
+        EXPECT_TRUE(this->fifo.push(std::span<test_type const>(in)));
+        EXPECT_EQ(3u, this->fifo.popUpTo(values));
+        EXPECT_EQ(in[0], values[0]);
+        EXPECT_EQ(in[1], values[1]);
+        EXPECT_EQ(in[2], values[2]);
+    }
+}
+
+
+template<typename FifoT> using BatchProxyTest = FifoTestBase<FifoT>;
+using BatchProxyFifoTypes = ::testing::Types<
+    Fifo5<test_type>,
+    Fifo5a<test_type>,
+    Fifo5c<test_type, 4>
+    >;
+TYPED_TEST_SUITE(BatchProxyTest, BatchProxyFifoTypes);
+
+TYPED_TEST(BatchProxyTest, properties) {
+        EXPECT_FALSE(std::is_copy_constructible_v<typename TestFixture::FifoType::batch_pusher_t>);
+        EXPECT_TRUE(std::is_move_constructible_v<typename TestFixture::FifoType::batch_pusher_t>);
+        EXPECT_FALSE(std::is_copy_assignable_v<typename TestFixture::FifoType::batch_pusher_t>);
+        EXPECT_TRUE(std::is_move_assignable_v<typename TestFixture::FifoType::batch_pusher_t>);
+
+        EXPECT_FALSE(std::is_copy_constructible_v<typename TestFixture::FifoType::batch_popper_t>);
+        EXPECT_TRUE(std::is_move_constructible_v<typename TestFixture::FifoType::batch_popper_t>);
+        EXPECT_FALSE(std::is_copy_assignable_v<typename TestFixture::FifoType::batch_popper_t>);
+        EXPECT_TRUE(std::is_move_assignable_v<typename TestFixture::FifoType::batch_popper_t>);
+}
+
+TYPED_TEST(BatchProxyTest, pushBatch) {
+    {
+        auto pusher = this->fifo.pushBatch(3);
+        ASSERT_TRUE(!!pusher);
+        ASSERT_EQ(3u, pusher.size());
+        for (auto i = 0u; i < pusher.size(); ++i) {
+            pusher.span()[i] = 42 + i;
+        }
+        EXPECT_TRUE(this->fifo.empty());
+    }
+    EXPECT_EQ(3u, this->fifo.size());
+
+    {
+        // capped by free space
+        auto pusher = this->fifo.pushBatch(3);
+        ASSERT_TRUE(!!pusher);
+        EXPECT_EQ(1u, pusher.size());
+        pusher.span()[0] = 45;
+    }
+    EXPECT_TRUE(this->fifo.full());
+    EXPECT_FALSE(!!this->fifo.pushBatch(1));
+
+    for (auto i = 0u; i < 4u; ++i) {
+        auto value = test_type{};
+        EXPECT_TRUE(this->fifo.pop(value));
+        EXPECT_EQ(42 + i, value);
+    }
+}
+
+TYPED_TEST(BatchProxyTest, inactiveIsEmpty) {
+    auto popper = this->fifo.popBatch(1);
+    EXPECT_FALSE(!!popper);
+    EXPECT_EQ(0u, popper.size());
+
+    for (auto i = 0u; i < this->fifo.capacity(); ++i) {
+        ASSERT_TRUE(this->fifo.push(i));
+    }
+    auto pusher = this->fifo.pushBatch(1);
+    EXPECT_FALSE(!!pusher);
+    EXPECT_EQ(0u, pusher.size());
+
+    EXPECT_EQ(0u, typename TestFixture::FifoType::batch_pusher_t{}.size());
+    EXPECT_EQ(0u, typename TestFixture::FifoType::batch_popper_t{}.size());
+}
+
+TYPED_TEST(BatchProxyTest, pushBatchWrap) {
+    auto value = test_type{};
+    for (auto i = 0u; i < 3u; ++i) {
+        this->fifo.push(42 + i);
+        this->fifo.pop(value);
+    }
+
+    // capped by the end of the ring
+    {
+        auto pusher = this->fifo.pushBatch(4);
+        ASSERT_TRUE(!!pusher);
+        ASSERT_EQ(1u, pusher.size());
+        pusher.span()[0] = 100;
+    }
+    {
+        auto pusher = this->fifo.pushBatch(4);
+        ASSERT_TRUE(!!pusher);
+        ASSERT_EQ(3u, pusher.size());
+        pusher.span()[0] = 101;
+        pusher.span()[1] = 102;
+        pusher.span()[2] = 103;
+    }
+    EXPECT_TRUE(this->fifo.full());
+
+    for (auto i = 0u; i < 4u; ++i) {
+        EXPECT_TRUE(this->fifo.pop(value));
+        EXPECT_EQ(100 + i, value);
+    }
+}
+
+TYPED_TEST(BatchProxyTest, pushBatchCommit) {
+    {
+        auto pusher = this->fifo.pushBatch(4);
+        ASSERT_EQ(4u, pusher.size());
+        pusher.span()[0] = 42;
+        pusher.span()[1] = 43;
+        pusher.commit(2);
+    }
+    EXPECT_EQ(2u, this->fifo.size());
+
+    {
+        auto pusher = this->fifo.pushBatch(2);
+        ASSERT_EQ(2u, pusher.size());
+        pusher.commit(0);
+    }
+    EXPECT_EQ(2u, this->fifo.size());
+
+    {
+        auto pusher = this->fifo.pushBatch(2);
+        ASSERT_EQ(2u, pusher.size());
+        pusher.release();
+        EXPECT_FALSE(!!pusher);
+    }
+    EXPECT_EQ(2u, this->fifo.size());
+}
+
+TYPED_TEST(BatchProxyTest, popBatch) {
+    EXPECT_FALSE(!!this->fifo.popBatch(1));
+    for (auto i = 0u; i < 3u; ++i) {
+        this->fifo.push(42 + i);
+    }
+
+    {
+        // capped by the number of elements
+        auto popper = this->fifo.popBatch(4);
+        ASSERT_TRUE(!!popper);
+        ASSERT_EQ(3u, popper.size());
+        for (auto i = 0u; i < popper.size(); ++i) {
+            EXPECT_EQ(42 + i, std::as_const(popper).span()[i]);
+        }
+        popper.commit(1);
+    }
+    EXPECT_EQ(2u, this->fifo.size());
+
+    {
+        auto popper = this->fifo.popBatch(4);
+        ASSERT_EQ(2u, popper.size());
+        popper.release();
+        EXPECT_FALSE(!!popper);
+    }
+    EXPECT_EQ(2u, this->fifo.size());
+
+    {
+        auto popper = this->fifo.popBatch(4);
+        ASSERT_EQ(2u, popper.size());
+        EXPECT_EQ(43u, popper.span()[0]);
+        EXPECT_EQ(44u, popper.span()[1]);
+    }
+    EXPECT_TRUE(this->fifo.empty());
+}
+
+TYPED_TEST(BatchProxyTest, move) {
+    auto pusher = this->fifo.pushBatch(2);
+    ASSERT_TRUE(!!pusher);
+
+    auto pusher2 = std::move(pusher);
+    EXPECT_FALSE(!!pusher);
+    ASSERT_TRUE(!!pusher2);
+    EXPECT_EQ(2u, pusher2.size());
+
+    pusher = std::move(pusher2);
+    EXPECT_TRUE(!!pusher);
+    EXPECT_FALSE(!!pusher2);
+    EXPECT_EQ(2u, pusher.size());
+}
+
+
+template<typename FifoT> using WaitTest = FifoTestBase<FifoT>;
+using WaitFifoTypes = ::testing::Types<
+    Fifo5<test_type, std::allocator<test_type>, NoStats, Padded64Layout, FutexWait>,
+    Fifo5a<test_type, std::allocator<test_type>, Padded64Layout, FutexWait>,
+    Fifo5b<test_type, std::allocator<test_type>, Padded64Layout, FutexWait>,
+    Fifo5c<test_type, 4, FutexWait>
+    >;
+TYPED_TEST_SUITE(WaitTest, WaitFifoTypes);
+
+template<typename FifoT>
+concept Waitable = requires(FifoT fifo, test_type value) { fifo.pushWait(value); fifo.popWait(value); };
+
+TYPED_TEST(WaitTest, optIn) {
+    EXPECT_TRUE(Waitable<typename TestFixture::FifoType>);
+    EXPECT_FALSE(Waitable<Fifo5<test_type>>);
+    EXPECT_FALSE(Waitable<Fifo5a<test_type>>);
+    EXPECT_FALSE(Waitable<Fifo5b<test_type>>);
+    EXPECT_FALSE((Waitable<Fifo5c<test_type, 4>>));
+}
+
+TYPED_TEST(WaitTest, timeout) {
+    using namespace std::chrono_literals;
+
+    auto value = test_type{};
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(this->fifo.popWait(value, 10ms));
+    EXPECT_LE(10ms, std::chrono::steady_clock::now() - start);
+
+    for (auto i = 0u; i < this->fifo.capacity(); ++i) {
+        EXPECT_TRUE(this->fifo.pushWait(42 + i, 10ms));
+    }
+    start = std::chrono::steady_clock::now();
+    EXPECT_FALSE(this->fifo.pushWait(24, 10ms));
+    EXPECT_LE(10ms, std::chrono::steady_clock::now() - start);
+
+    for (auto i = 0u; i < this->fifo.capacity(); ++i) {
+        EXPECT_TRUE(this->fifo.popWait(value, 10ms));
+        EXPECT_EQ(42 + i, value);
+    }
+    EXPECT_TRUE(this->fifo.empty());
+}
+
+TYPED_TEST(WaitTest, wakeup) {
+    using namespace std::chrono_literals;
+
+    constexpr auto count = 1000u;
+    auto t = std::jthread([&] {
+        for (auto i = 0u; i < count; ++i) {
+            if (i % 100 == 0) {
+                std::this_thread::sleep_for(1ms);
+            }
+            this->fifo.pushWait(i);
+        }
+    });
+
+    for (auto i = 0u; i < count; ++i) {
+        if (i % 100 == 50) {
+            // let the fifo fill so the push thread parks
+            std::this_thread::sleep_for(1ms);
+        }
+        auto value = test_type{};
+        this->fifo.popWait(value);
+        ASSERT_EQ(i, value);
+    }
+}
+
+
+/// The same fifo type with the NoStats policy
+template<typename FifoT> struct WithoutStats;
+template<template<typename, typename, typename, typename...> class FifoT, typename T, typename Alloc, typename Stats, typename... Rest>
+struct WithoutStats<FifoT<T, Alloc, Stats, Rest...>> { using type = FifoT<T, Alloc, NoStats, Rest...>; };
+
+template<typename FifoT> using StatsTest = FifoTestBase<FifoT>;
+using StatsFifoTypes = ::testing::Types<
+    Fifo4<test_type, std::allocator<test_type>, CounterStats>,
+    Fifo5<test_type, std::allocator<test_type>, CounterStats>
+    >;
+TYPED_TEST_SUITE(StatsTest, StatsFifoTypes);
+
+TYPED_TEST(StatsTest, properties) {
+    using FifoType = typename TestFixture::FifoType;
+    using NoStatsFifoType = typename WithoutStats<FifoType>::type;
+    EXPECT_EQ(sizeof(NoStatsFifoType), sizeof(FifoType));
+    EXPECT_FALSE(requires(NoStatsFifoType fifo) { fifo.stats(); });
+}
+
+TYPED_TEST(StatsTest, counters) {
+    auto stats = this->fifo.stats();
+    EXPECT_EQ(0u, stats.push.refreshes);
+    EXPECT_EQ(0u, stats.pop.refreshes);
+
+    auto value = test_type{};
+    EXPECT_FALSE(this->fifo.pop(value));
+    stats = this->fifo.stats();
+    EXPECT_EQ(1u, stats.pop.refreshes);
+    EXPECT_EQ(1u, stats.pop.failures);
+    EXPECT_EQ(0u, stats.pop.highWater);
+
+    // The cached pop cursor shows room for capacity() pushes
+    for (auto i = 0u; i < this->fifo.capacity(); ++i) {
+        EXPECT_TRUE(this->fifo.push(42 + i));
+    }
+    EXPECT_EQ(0u, this->fifo.stats().push.refreshes);
+    EXPECT_FALSE(this->fifo.push(24));
+    stats = this->fifo.stats();
+    EXPECT_EQ(1u, stats.push.refreshes);
+    EXPECT_EQ(1u, stats.push.failures);
+    EXPECT_EQ(4u, stats.push.highWater);
+
+    // One refresh of the cached push cursor covers all the pops
+    for (auto i = 0u; i < this->fifo.capacity(); ++i) {
+        EXPECT_TRUE(this->fifo.pop(value));
+        EXPECT_EQ(42 + i, value);
+    }
+    stats = this->fifo.stats();
+    EXPECT_EQ(2u, stats.pop.refreshes);
+    EXPECT_EQ(1u, stats.pop.failures);
+    EXPECT_EQ(4u, stats.pop.highWater);
+}
+
+
+TEST(MpscFifoTest, releaseSkips) {
+    auto fifo = MpscFifo<test_type>{4};
+
+    // Released between two published pushes
+    fifo.push(1);
+    {
+        auto released = fifo.push();
+        fifo.push(2);
+        released.release();
+    }
+    fifo.push(3);
+    EXPECT_EQ(4u, fifo.size());
+
+    auto value = test_type{};
+    for (auto expected : {1u, 2u, 3u}) {
+        EXPECT_TRUE(fifo.pop(value));
+        EXPECT_EQ(expected, value);
+    }
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_FALSE(fifo.pop(value));
+
+    // The released slot is reused on the next lap
+    for (auto i = 0u; i < fifo.capacity(); ++i) {
+        EXPECT_TRUE(fifo.push(42 + i));
+    }
+    EXPECT_TRUE(fifo.full());
+    EXPECT_FALSE(fifo.push(24));
+}
+
+TEST(MpscFifoTest, producers) {
+    constexpr auto producers = 4u;
+    constexpr auto count = 10000u;
+    auto fifo = MpscFifo<test_type>{16};
+
+    {
+        auto threads = std::vector<std::jthread>{};
+        for (auto producer = 0u; producer < producers; ++producer) {
+            // A failed assertion below leaves the fifo full; the jthreads'
+            // destructors then stop the producers before joining them
+            threads.emplace_back([&fifo, producer](std::stop_token stop) {
+                for (auto i = 0u; i < count; ++i) {
+                    while (not fifo.push(producer * count + i)) {
+                        if (stop.stop_requested()) {
+                            return;
+                        }
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+
+        // Each producer's values arrive in order
+        auto next = std::array<test_type, producers>{};
+        for (auto i = 0u; i < producers * count; ++i) {
+            auto value = test_type{};
+            while (not fifo.pop(value)) {
+                std::this_thread::yield();
+            }
+            auto producer = value / count;
+            ASSERT_LT(producer, producers);
+            ASSERT_EQ(next[producer]++, value % count);
+        }
+    }
+    EXPECT_TRUE(fifo.empty());
+}
+
+
+template<typename FifoT> using MpmcTest = FifoTestBase<FifoT>;
+using MpmcFifoTypes = ::testing::Types<
+    MpmcFifo<test_type>,
+    MpmcFifo<test_type, std::allocator<test_type>, true>
+    >;
+TYPED_TEST_SUITE(MpmcTest, MpmcFifoTypes);
+
+TYPED_TEST(MpmcTest, producersConsumers) {
+    constexpr auto producers = 3u;
+    constexpr auto consumers = 3u;
+    constexpr auto count = 10000u;
+
+    auto popped = std::array<std::vector<test_type>, consumers>{};
+    {
+        // Declared before the threads so that it outlives their joins
+        auto remaining = std::atomic<unsigned>{producers * count};
+        auto threads = std::vector<std::jthread>{};
+        for (auto producer = 0u; producer < producers; ++producer) {
+            threads.emplace_back([this, producer] {
+                for (auto i = 0u; i < count; ++i) {
+                    while (not this->fifo.push(producer * count + i)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto consumer = 0u; consumer < consumers; ++consumer) {
+            threads.emplace_back([this, &remaining, &values = popped[consumer]] {
+                while (remaining.load() != 0) {
+                    auto value = test_type{};
+                    if (this->fifo.pop(value)) {
+                        values.push_back(value);
+                        --remaining;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+    }
+    EXPECT_TRUE(this->fifo.empty());
+
+    // Every value is popped once and each consumer sees each producer's
+    // values in order
+    auto seen = std::vector<bool>(producers * count);
+    for (auto const& values : popped) {
+        auto last = std::array<long, producers>{-1, -1, -1};
+        for (auto value : values) {
+            ASSERT_LT(value, producers * count);
+            EXPECT_FALSE(seen[value]);
+            seen[value] = true;
+            auto producer = value / count;
+            EXPECT_LT(last[producer], long(value % count));
+            last[producer] = value % count;
+        }
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), false), 0);
+}
+
+
+TEST(BroadcastFifoTest, initialConditions) {
+    auto fifo = BroadcastFifo<test_type>{4, 2};
+    EXPECT_EQ(4u, fifo.capacity());
+    EXPECT_EQ(2u, fifo.consumers());
+    EXPECT_EQ(0u, fifo.size());
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_TRUE(fifo.empty(0));
+    EXPECT_TRUE(fifo.empty(1));
+    EXPECT_FALSE(fifo.full());
+}
+
+TEST(BroadcastFifoTest, everyConsumerPopsEveryElement) {
+    auto fifo = BroadcastFifo<test_type>{4, 2};
+    for (auto i = 0u; i < fifo.capacity(); ++i) {
+        EXPECT_TRUE(fifo.push(42 + i));
+    }
+    EXPECT_TRUE(fifo.full());
+    EXPECT_FALSE(fifo.push(24));
+
+    auto value = test_type{};
+    for (auto i = 0u; i < fifo.capacity(); ++i) {
+        EXPECT_TRUE(fifo.pop(0, value));
+        EXPECT_EQ(42 + i, value);
+    }
+    EXPECT_TRUE(fifo.empty(0));
+    EXPECT_FALSE(fifo.pop(0, value));
+
+    // Consumer 1 has popped nothing so the fifo is still full
+    EXPECT_EQ(4u, fifo.size(1));
+    EXPECT_TRUE(fifo.full());
+    EXPECT_FALSE(fifo.push(24));
+
+    {
+        auto popper = fifo.pop(1);
+        ASSERT_TRUE(!!popper);
+        EXPECT_EQ(42u, *popper);
+    }
+    EXPECT_FALSE(fifo.full());
+    EXPECT_TRUE(fifo.push(46));
+
+    for (auto i = 1u; i <= fifo.capacity(); ++i) {
+        EXPECT_TRUE(fifo.pop(1, value));
+        EXPECT_EQ(42 + i, value);
+    }
+    EXPECT_TRUE(fifo.pop(0, value));
+    EXPECT_EQ(46u, value);
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(BroadcastFifoTest, popperRelease) {
+    auto fifo = BroadcastFifo<test_type>{4, 1};
+    fifo.push() = 42;
+    {
+        auto popper = fifo.pop(0);
+        ASSERT_TRUE(!!popper);
+        popper.release();
+        EXPECT_FALSE(!!popper);
+    }
+    EXPECT_EQ(42u, *fifo.pop(0));
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(BroadcastFifoTest, consumers) {
+    constexpr auto consumers = 3u;
+    constexpr auto count = 10000u;
+    auto fifo = BroadcastFifo<test_type>{16, consumers};
+
+    auto threads = std::vector<std::jthread>{};
+    for (auto consumer = 0u; consumer < consumers; ++consumer) {
+        threads.emplace_back([&fifo, consumer] {
+            for (auto i = 0u; i < count; ++i) {
+                auto value = test_type{};
+                while (not fifo.pop(consumer, value)) {
+                    std::this_thread::yield();
+                }
+                ASSERT_EQ(i, value);
+            }
+        });
+    }
+    for (auto i = 0u; i < count; ++i) {
+        while (not fifo.push(i)) {
+            std::this_thread::yield();
+        }
+    }
+    threads.clear();
+    EXPECT_TRUE(fifo.empty());
+}
+
+
+TEST(SpmcFifoTest, pusherRelease) {
+    auto fifo = SpmcFifo<test_type>{4};
+    fifo.push() = 42;
+    {
+        auto pusher = fifo.push();
+        ASSERT_TRUE(!!pusher);
+        pusher = 24;
+        pusher.release();
+    }
+    EXPECT_EQ(1u, fifo.size());
+    EXPECT_EQ(42u, *fifo.pop());
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(SpmcFifoTest, slotFreedByPopper) {
+    auto fifo = SpmcFifo<test_type>{4};
+    for (auto i = 0u; i < fifo.capacity(); ++i) {
+        EXPECT_TRUE(fifo.push(42 + i));
+    }
+
+    // Claimed but not yet popped so the push thread may not reuse the slot
+    auto popper = fifo.pop();
+    ASSERT_TRUE(!!popper);
+    EXPECT_EQ(42u, *popper);
+    EXPECT_EQ(3u, fifo.size());
+    EXPECT_FALSE(fifo.push(24));
+
+    popper = fifo.pop();
+    EXPECT_EQ(43u, *popper);
+    EXPECT_TRUE(fifo.push(46));
+}
+
+TEST(SpmcFifoTest, consumers) {
+    constexpr auto consumers = 3u;
+    constexpr auto count = 30000u;
+    auto fifo = SpmcFifo<test_type>{16};
+
+    auto popped = std::array<std::vector<test_type>, consumers>{};
+    {
+        auto done = std::atomic<bool>{};
+        auto threads = std::vector<std::jthread>{};
+        for (auto consumer = 0u; consumer < consumers; ++consumer) {
+            threads.emplace_back([&fifo, &done, &values = popped[consumer]] {
+                while (not done.load() || not fifo.empty()) {
+                    if (auto popper = fifo.pop(); popper) {
+                        values.push_back(*popper);
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto i = 0u; i < count; ++i) {
+            while (not fifo.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+    }
+
+    // Every value is popped by exactly one consumer, in order
+    auto seen = std::vector<bool>(count);
+    for (auto const& values : popped) {
+        EXPECT_TRUE(std::is_sorted(values.begin(), values.end()));
+        for (auto value : values) {
+            ASSERT_LT(value, count);
+            EXPECT_FALSE(seen[value]);
+            seen[value] = true;
+        }
+    }
+    EXPECT_EQ(std::count(seen.begin(), seen.end(), false), 0);
+}
+
+TEST(SpmcFifoTest, sizeFromConsumers) {
+    constexpr auto consumers = 2u;
+    constexpr auto count = 10'000u;
+    auto fifo = SpmcFifo<test_type>{16};
+
+    auto popped = std::atomic<unsigned>{};
+    {
+        auto threads = std::vector<std::jthread>{};
+        for (auto consumer = 0u; consumer < consumers; ++consumer) {
+            threads.emplace_back([&] {
+                while (popped.load() < count) {
+                    if (auto popper = fifo.pop(); popper) {
+                        ++popped;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                    // Never wraps, even just after claiming a slot
+                    ASSERT_LE(fifo.size(), fifo.capacity());
+                }
+            });
+        }
+        for (auto i = 0u; i < count; ++i) {
+            while (not fifo.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    EXPECT_TRUE(fifo.empty());
+}
+
+
+TEST(ShmFifoTest, sharedBetweenHandles) {
+    auto pushSide = ShmFifo<int>::createAnonymous(4);
+    auto popSide = ShmFifo<int>::attach(pushSide.fd());
+    EXPECT_EQ(4u, popSide.capacity());
+    EXPECT_TRUE(popSide.empty());
+
+    // Each handle has its own mapping of the same memory
+    ASSERT_TRUE(pushSide.push(42));
+    ASSERT_TRUE(pushSide.push(43));
+    EXPECT_EQ(2u, popSide.size());
+
+    auto value = 0;
+    ASSERT_TRUE(popSide.pop(value));
+    EXPECT_EQ(42, value);
+    ASSERT_TRUE(popSide.pop(value));
+    EXPECT_EQ(43, value);
+    EXPECT_FALSE(popSide.pop(value));
+    EXPECT_TRUE(pushSide.empty());
+
+    // Wrap around
+    for (auto i = 0; i < 4; ++i) {
+        ASSERT_TRUE(pushSide.push(i));
+    }
+    EXPECT_FALSE(pushSide.push(4));
+    EXPECT_TRUE(popSide.full());
+    for (auto i = 0; i < 4; ++i) {
+        ASSERT_TRUE(popSide.pop(value));
+        EXPECT_EQ(i, value);
+    }
+}
+
+TEST(ShmFifoTest, attachRejectsMismatch) {
+    auto fifo = ShmFifo<int>::createAnonymous(4);
+    EXPECT_THROW(ShmFifo<double>::attach(fifo.fd()), std::system_error);
+
+    auto notFifo = ::memfd_create("notFifo", MFD_CLOEXEC);
+    ASSERT_NE(-1, notFifo);
+    ASSERT_NE(-1, ::ftruncate(notFifo, 4096));
+    EXPECT_THROW(ShmFifo<int>::attach(notFifo), std::system_error);
+    ::close(notFifo);
+}
+
+TEST(ShmFifoTest, moveHandle) {
+    auto fifo = ShmFifo<int>::createAnonymous(4);
+    ASSERT_TRUE(fifo.push(1));
+    auto moved = std::move(fifo);
+    EXPECT_EQ(-1, fifo.fd());
+    auto value = 0;
+    ASSERT_TRUE(moved.pop(value));
+    EXPECT_EQ(1, value);
+}
+
+TEST(HugePageAllocatorTest, alignedAndUsable) {
+    auto alloc = HugePageAllocator<std::int64_t>{};
+    auto* p = alloc.allocate(3);
+    EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(p) % (std::size_t{1} << 21));
+    p[0] = 1;
+    p[2] = 3;
+    EXPECT_EQ(1, p[0]);
+    EXPECT_EQ(3, p[2]);
+    alloc.deallocate(p, 3);
+}
+
+TEST(HugePageAllocatorTest, fifo) {
+    auto fifo = Fifo5a<std::int64_t, HugePageAllocator<std::int64_t>>(1024*1024);
+    for (auto lap = 0; lap < 2; ++lap) {
+        for (auto i = std::int64_t{}; i < 1024*1024; ++i) {
+            ASSERT_TRUE(fifo.push(i));
+        }
+        EXPECT_TRUE(fifo.full());
+        auto value = std::int64_t{};
+        for (auto i = std::int64_t{}; i < 1024*1024; ++i) {
+            ASSERT_TRUE(fifo.pop(value));
+            ASSERT_EQ(i, value);
+        }
+        EXPECT_TRUE(fifo.empty());
+    }
+}
+
+TEST(NumaAllocatorTest, fifo) {
+    // Node 0 always exists, even on kernels without NUMA support
+    for (auto node : {-1, 0}) {
+        auto fifo = Fifo5<int, NumaAllocator<int>>(1024, NumaAllocator<int>(node));
+        for (auto i = 0; i < 1024; ++i) {
+            ASSERT_TRUE(fifo.push(i));
+        }
+        auto value = 0;
+        for (auto i = 0; i < 1024; ++i) {
+            ASSERT_TRUE(fifo.pop(value));
+            ASSERT_EQ(i, value);
+        }
+    }
+}
+
+TEST(NumaAllocatorTest, invalidNode) {
+    EXPECT_THROW(NumaAllocator<int>(numa::maxNodes).allocate(1), std::system_error);
+}
+
+TEST(UnboundedFifoTest, growsAcrossBlocks) {
+    auto fifo = UnboundedFifo<int>(4);
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_EQ(4u, fifo.blockCapacity());
+
+    for (auto i = 0; i < 10; ++i) {
+        ASSERT_TRUE(fifo.push(i));
+    }
+    EXPECT_EQ(10u, fifo.size());
+    EXPECT_EQ(3u, fifo.allocatedBlocks());
+
+    auto value = 0;
+    for (auto i = 0; i < 10; ++i) {
+        ASSERT_TRUE(fifo.pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(fifo.pop(value));
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(UnboundedFifoTest, recyclesBlocks) {
+    auto fifo = UnboundedFifo<int>(4);
+    auto value = 0;
+    for (auto round = 0; round < 100; ++round) {
+        for (auto i = 0; i < 6; ++i) {
+            ASSERT_TRUE(fifo.push(round * 6 + i));
+        }
+        for (auto i = 0; i < 6; ++i) {
+            ASSERT_TRUE(fifo.pop(value));
+            ASSERT_EQ(round * 6 + i, value);
+        }
+    }
+    // At most three blocks are ever in use: a partly popped one, a full
+    // one and a partly pushed one
+    EXPECT_LE(fifo.allocatedBlocks(), 3u);
+}
+
+TEST(UnboundedFifoTest, releaseAtBlockEnd) {
+    auto fifo = UnboundedFifo<int>(2);
+    ASSERT_TRUE(fifo.push(0));
+    ASSERT_TRUE(fifo.push(1));
+
+    // The push at the start of the second block is abandoned then retried
+    fifo.push().release();
+    ASSERT_TRUE(fifo.push(2));
+    EXPECT_EQ(2u, fifo.allocatedBlocks());
+
+    auto value = 0;
+    ASSERT_TRUE(fifo.pop(value));
+    ASSERT_TRUE(fifo.pop(value));
+    fifo.pop().release();
+    ASSERT_TRUE(fifo.pop(value));
+    EXPECT_EQ(2, value);
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(UnboundedFifoTest, threads) {
+    constexpr auto count = 10'000;
+    auto fifo = UnboundedFifo<int>(64);
+
+    auto consumer = std::jthread([&] {
+        for (auto i = 0; i < count; ++i) {
+            auto value = 0;
+            while (not fifo.pop(value)) {
+                std::this_thread::yield();
+            }
+            ASSERT_EQ(i, value);
+        }
+    });
+    for (auto i = 0; i < count; ++i) {
+        ASSERT_TRUE(fifo.push(i));
+    }
+    consumer.join();
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(Fifo5dTest, deferredPush) {
+    auto fifo = Fifo5d<int, 2, 2>(8);
+    auto value = 0;
+
+    // The first push of a batch is not published
+    ASSERT_TRUE(fifo.push(1));
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_FALSE(fifo.pop(value));
+
+    // The second completes the batch
+    ASSERT_TRUE(fifo.push(2));
+    EXPECT_EQ(2u, fifo.size());
+
+    // flushPush() publishes a partial batch
+    ASSERT_TRUE(fifo.push(3));
+    EXPECT_EQ(2u, fifo.size());
+    fifo.flushPush();
+    EXPECT_EQ(3u, fifo.size());
+
+    for (auto i = 1; i <= 3; ++i) {
+        ASSERT_TRUE(fifo.pop(value));
+        EXPECT_EQ(i, value);
+    }
+}
+
+TEST(Fifo5dTest, deferredPop) {
+    auto fifo = Fifo5d<int, 1, 4>(4);
+    for (auto i = 0; i < 4; ++i) {
+        ASSERT_TRUE(fifo.push(i));
+    }
+
+    auto value = 0;
+    ASSERT_TRUE(fifo.pop(value));
+    ASSERT_TRUE(fifo.pop(value));
+    EXPECT_TRUE(fifo.full());
+    EXPECT_FALSE(fifo.push(4));
+    fifo.flushPop();
+    EXPECT_EQ(2u, fifo.size());
+    ASSERT_TRUE(fifo.push(4));
+
+    // Finding the fifo empty publishes the pop cursor
+    for (auto i = 2; i <= 4; ++i) {
+        ASSERT_TRUE(fifo.pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_EQ(3u, fifo.size());
+    EXPECT_FALSE(fifo.pop(value));
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(Fifo5dTest, fullPublishes) {
+    auto fifo = Fifo5d<int, 8, 1>(4);
+    for (auto i = 0; i < 4; ++i) {
+        ASSERT_TRUE(fifo.push(i));
+    }
+    EXPECT_TRUE(fifo.empty());
+
+    // Finding the fifo full publishes the push cursor so the pop thread
+    // can drain it
+    EXPECT_FALSE(fifo.push(4));
+    EXPECT_TRUE(fifo.full());
+}
+
+TEST(Fifo5dTest, threads) {
+    constexpr auto count = 10'003;
+    auto fifo = Fifo5d<int, 16, 16>(64);
+
+    auto consumer = std::jthread([&] {
+        for (auto i = 0; i < count; ++i) {
+            auto value = 0;
+            while (not fifo.pop(value)) {
+                std::this_thread::yield();
+            }
+            ASSERT_EQ(i, value);
+        }
+        fifo.flushPop();
+    });
+    for (auto i = 0; i < count; ++i) {
+        while (not fifo.push(i)) {
+            std::this_thread::yield();
+        }
+    }
+    fifo.flushPush();
+    consumer.join();
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(Fifo5eTest, moveOnly) {
+    auto fifo = Fifo5e<std::unique_ptr<int>>(4);
+    auto value = std::make_unique<int>(42);
+    ASSERT_TRUE(fifo.push(std::move(value)));
+    EXPECT_FALSE(value);
+    ASSERT_TRUE(fifo.emplace(new int(43)));
+
+    {
+        auto pusher = fifo.push();
+        ASSERT_TRUE(!!pusher);
+        pusher.emplace(std::make_unique<int>(44));
+    }
+    EXPECT_EQ(3u, fifo.size());
+
+    ASSERT_TRUE(fifo.pop(value));
+    EXPECT_EQ(42, *value);
+    {
+        auto popper = fifo.pop();
+        ASSERT_TRUE(!!popper);
+        EXPECT_EQ(43, **popper);
+        value = std::move(*popper);
+    }
+    EXPECT_EQ(43, *value);
+    EXPECT_EQ(44, **fifo.pop());
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(Fifo5eTest, pushFullLeavesValue) {
+    auto fifo = Fifo5e<std::unique_ptr<int>>(1);
+    ASSERT_TRUE(fifo.push(std::make_unique<int>(1)));
+    auto value = std::make_unique<int>(2);
+    EXPECT_FALSE(fifo.push(std::move(value)));
+    ASSERT_TRUE(value);
+    EXPECT_EQ(2, *value);
+}
+
+struct Lifetime
+{
+    static inline int live = 0;
+    std::string text;
+
+    explicit Lifetime(std::string text) : text{std::move(text)} { ++live; }
+    Lifetime(Lifetime const& other) : text{other.text} { ++live; }
+    Lifetime(Lifetime&& other) noexcept : text{std::move(other.text)} { ++live; }
+    Lifetime& operator=(Lifetime const&) = default;
+    Lifetime& operator=(Lifetime&&) noexcept = default;
+    ~Lifetime() { --live; }
+};
+
+TEST(Fifo5eTest, destroysInPlace) {
+    {
+        auto fifo = Fifo5e<Lifetime>(4);
+        ASSERT_TRUE(fifo.emplace("a long string that does not fit in the small buffer"));
+        ASSERT_TRUE(fifo.emplace("b"));
+        ASSERT_TRUE(fifo.emplace("c"));
+        EXPECT_EQ(3, Lifetime::live);
+
+        // Popped elements are destroyed in the ring
+        EXPECT_EQ("a long string that does not fit in the small buffer", fifo.pop()->text);
+        EXPECT_EQ(2, Lifetime::live);
+
+        // A released pusher destroys what it constructed
+        {
+            auto pusher = fifo.push();
+            pusher.emplace("d");
+            EXPECT_EQ(3, Lifetime::live);
+            pusher.release();
+        }
+        EXPECT_EQ(2, Lifetime::live);
+        EXPECT_EQ(2u, fifo.size());
+
+        // A pusher that constructs nothing pushes nothing
+        fifo.push();
+        EXPECT_EQ(2u, fifo.size());
+
+        // Assigning over an active pusher destroys what it constructed
+        {
+            auto pusher = fifo.push();
+            pusher.emplace("e");
+            EXPECT_EQ(3, Lifetime::live);
+            pusher = Fifo5e<Lifetime>::pusher_t{};
+            EXPECT_EQ(2, Lifetime::live);
+        }
+        EXPECT_EQ(2u, fifo.size());
+    }
+    // The fifo destroys what is left
+    EXPECT_EQ(0, Lifetime::live);
+}
+
+TEST(FastForwardFifoTest, threads) {
+    constexpr auto count = 10'000;
+    auto fifo = FastForwardFifo<int>(16);
+
+    auto consumer = std::jthread([&] {
+        for (auto i = 0; i < count; ++i) {
+            auto value = 0;
+            while (not fifo.pop(value)) {
+                std::this_thread::yield();
+            }
+            ASSERT_EQ(i, value);
+            // Either thread may call size()
+            ASSERT_LE(fifo.size(), fifo.capacity());
+        }
+    });
+    for (auto i = 0; i < count; ++i) {
+        while (not fifo.push(i)) {
+            std::this_thread::yield();
+        }
+        ASSERT_LE(fifo.size(), fifo.capacity());
+    }
+    consumer.join();
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(BQueueTest, backtracking) {
+    auto fifo = BQueue<int, std::allocator<int>, 8>(16);
+
+    // Fewer elements than a batch are found by backtracking
+    ASSERT_TRUE(fifo.push(0));
+    ASSERT_TRUE(fifo.push(1));
+    ASSERT_TRUE(fifo.push(2));
+    auto value = 0;
+    for (auto i = 0; i < 3; ++i) {
+        ASSERT_TRUE(fifo.pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_FALSE(fifo.pop(value));
+
+    // As are the last free slots
+    for (auto i = 3; i < 19; ++i) {
+        ASSERT_TRUE(fifo.push(i));
+    }
+    EXPECT_TRUE(fifo.full());
+    EXPECT_FALSE(fifo.push(19));
+    for (auto i = 3; i < 19; ++i) {
+        ASSERT_TRUE(fifo.pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(BQueueTest, threads) {
+    constexpr auto count = 10'000;
+    auto fifo = BQueue<int, std::allocator<int>, 8>(32);
+
+    auto consumer = std::jthread([&] {
+        for (auto i = 0; i < count; ++i) {
+            auto value = 0;
+            while (not fifo.pop(value)) {
+                std::this_thread::yield();
+            }
+            ASSERT_EQ(i, value);
+            // Either thread may call size()
+            ASSERT_LE(fifo.size(), fifo.capacity());
+        }
+    });
+    for (auto i = 0; i < count; ++i) {
+        while (not fifo.push(i)) {
+            std::this_thread::yield();
+        }
+        ASSERT_LE(fifo.size(), fifo.capacity());
+    }
+    consumer.join();
+    EXPECT_TRUE(fifo.empty());
+}
+
+TEST(LayoutTest, footprint) {
+    // One line for the ring's pointer and size, then one per cursor group
+    EXPECT_EQ(3*64u, sizeof(Fifo4a<test_type, std::allocator<test_type>, CompactLayout>));
+    EXPECT_EQ(5*64u, sizeof(Fifo4a<test_type, std::allocator<test_type>, Padded64Layout>));
+    EXPECT_EQ(5*128u, sizeof(Fifo4a<test_type, std::allocator<test_type>, Padded128Layout>));
+
+    // Blocking is opt-in, so the same as Fifo4a
+    EXPECT_EQ(3*64u, sizeof(Fifo5a<test_type, std::allocator<test_type>, CompactLayout>));
+    EXPECT_EQ(5*64u, sizeof(Fifo5a<test_type>));
+    EXPECT_EQ(5*128u, sizeof(Fifo5a<test_type, std::allocator<test_type>, Padded128Layout>));
+
+    // Plus a line for each waiting flag
+    EXPECT_EQ(7*64u, sizeof(Fifo5a<test_type, std::allocator<test_type>, Padded64Layout, FutexWait>));
+}
+
+TEST(LayoutTest, compactFifo) {
+    auto fifo = Fifo5a<test_type, AlignedAllocator<test_type>, CompactLayout>(4);
+    auto value = test_type{};
+    for (auto lap = 0u; lap < 3; ++lap) {
+        for (auto i = 0u; i < 4; ++i) {
+            ASSERT_TRUE(fifo.push(lap*4 + i));
+        }
+        EXPECT_FALSE(fifo.push(0));
+        for (auto i = 0u; i < 4; ++i) {
+            ASSERT_TRUE(fifo.pop(value));
+            EXPECT_EQ(lap*4 + i, value);
+        }
+        EXPECT_FALSE(fifo.pop(value));
+    }
+}
+
+TEST(AlignedAllocatorTest, aligned) {
+    auto alloc = AlignedAllocator<std::int64_t>{};
+    for (auto n : {1u, 3u, 100'000u}) {
+        auto* p = alloc.allocate(n);
+        EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(p) % 128);
+        p[n - 1] = 1;
+        alloc.deallocate(p, n);
+    }
+
+    auto rebound = std::allocator_traits<AlignedAllocator<std::int64_t, 64>>::rebind_alloc<char>{};
+    auto* p = rebound.allocate(1);
+    EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(p) % 64);
+    rebound.deallocate(p, 1);
+}
+
+template<typename FifoT> using PolicyFifoTest = FifoTestBase<FifoT>;
+using PolicyFifoTypes = ::testing::Types<
+    Fifo<test_type, std::allocator<test_type>, ModuloIndex>,
+    Fifo<test_type, std::allocator<test_type>, ConstrainedIndex>,
+    Fifo<test_type, std::allocator<test_type>, ConstrainedIndex, AtomicCursor, false>
+    >;
+TYPED_TEST_SUITE(PolicyFifoTest, PolicyFifoTypes);
+
+TYPED_TEST(PolicyFifoTest, anyCapacity) {
+    auto fifo = typename TestFixture::FifoType(5);
+    EXPECT_EQ(5u, fifo.capacity());
+
+    auto value = test_type{};
+    for (auto lap = 0u; lap < 3; ++lap) {
+        for (auto i = 0u; i < 5; ++i) {
+            ASSERT_TRUE(fifo.push(lap*5 + i));
+            EXPECT_EQ(i + 1, fifo.size());
+        }
+        EXPECT_TRUE(fifo.full());
+        EXPECT_FALSE(fifo.push(0));
+        for (auto i = 0u; i < 3; ++i) {
+            ASSERT_TRUE(fifo.pop(value));
+            EXPECT_EQ(lap*5 + i, value);
+        }
+        EXPECT_EQ(2u, fifo.size());
+        for (auto i = 3u; i < 5; ++i) {
+            ASSERT_TRUE(fifo.pop(value));
+            EXPECT_EQ(lap*5 + i, value);
+        }
+        EXPECT_TRUE(fifo.empty());
+        EXPECT_FALSE(fifo.pop(value));
+    }
+}
+
+TYPED_TEST(PolicyFifoTest, threads) {
+    constexpr auto count = 10'000u;
+    auto fifo = typename TestFixture::FifoType(7);
+
+    auto consumer = std::jthread([&] {
+        for (auto i = 0u; i < count; ++i) {
+            auto value = test_type{};
+            while (not fifo.pop(value)) {
+                std::this_thread::yield();
+            }
+            ASSERT_EQ(i, value);
+        }
+    });
+    for (auto i = 0u; i < count; ++i) {
+        while (not fifo.push(i)) {
+            std::this_thread::yield();
+        }
+    }
+    consumer.join();
+    EXPECT_TRUE(fifo.empty());
+}
+
 struct ABC
 {
     int a;
@@ -327,3 +1623,238 @@ TYPED_TEST(ProxyMoveTest, pusherUsesValueSizeTraits) {
     EXPECT_EQ(3, popper->c);
 
 }
+
+
+class ByteFifoTest : public testing::Test {
+public:
+    // 64 bytes holds four 8 byte messages (header plus payload)
+    ByteFifo<> fifo{64};
+
+    static auto message(std::string_view text) {
+        return std::as_bytes(std::span(text));
+    }
+    static auto text(std::span<std::byte const> message) {
+        return std::string_view(reinterpret_cast<char const*>(message.data()), message.size());
+    }
+};
+
+TEST_F(ByteFifoTest, initialConditions) {
+    EXPECT_EQ(64u, fifo.capacity());
+    EXPECT_EQ(0u, fifo.size());
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_TRUE(fifo.peek().empty());
+}
+
+TEST_F(ByteFifoTest, reserveCommit) {
+    auto buffer = fifo.reserve(5);
+    ASSERT_EQ(5u, buffer.size());
+    std::memcpy(buffer.data(), "hello", 5);
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_TRUE(fifo.peek().empty());
+
+    fifo.commit();
+    EXPECT_EQ(16u, fifo.size());
+    EXPECT_EQ("hello", text(fifo.peek()));
+}
+
+TEST_F(ByteFifoTest, commitLess) {
+    auto buffer = fifo.reserve(20);
+    ASSERT_EQ(20u, buffer.size());
+    std::memcpy(buffer.data(), "hello", 5);
+    fifo.commit(5);
+    EXPECT_EQ(16u, fifo.size());
+    EXPECT_EQ("hello", text(fifo.peek()));
+}
+
+TEST_F(ByteFifoTest, peekRelease) {
+    EXPECT_TRUE(fifo.push(message("one")));
+    EXPECT_TRUE(fifo.push(message("two three")));
+
+    EXPECT_EQ("one", text(fifo.peek()));
+    EXPECT_EQ("one", text(fifo.peek()));
+    fifo.release();
+    EXPECT_EQ("two three", text(fifo.peek()));
+    fifo.release();
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_TRUE(fifo.peek().empty());
+}
+
+TEST_F(ByteFifoTest, full) {
+    for (auto i = 0; i < 4; ++i) {
+        EXPECT_TRUE(fifo.push(message("1234567")));
+    }
+    EXPECT_EQ(64u, fifo.size());
+    EXPECT_TRUE(fifo.reserve(1).empty());
+
+    fifo.peek();
+    fifo.release();
+    EXPECT_TRUE(fifo.push(message("abc")));
+    EXPECT_TRUE(fifo.reserve(1).empty());
+}
+
+TEST_F(ByteFifoTest, maxMessageSizeFitsAnywhere) {
+    // A 32 byte record, half the ring
+    ASSERT_EQ(24u, fifo.maxMessageSize());
+    auto const large = std::string(fifo.maxMessageSize(), 'x');
+
+    // Every cursor position, including those where the record must skip
+    // to the start of the ring
+    for (auto offset = 0u; offset < 64u; offset += 8) {
+        // Advance the cursor to `offset` with 24 and 16 byte records
+        auto fifo = ByteFifo<>{64};
+        auto advance = [&](std::string_view text) {
+            ASSERT_TRUE(fifo.push(message(text)));
+            fifo.peek();
+            fifo.release();
+        };
+        auto cursor = 0u;
+        if (offset % 16 != 0) {
+            advance("123456789");
+            cursor += 24;
+        }
+        while (cursor % 64 != offset) {
+            advance("1234567");
+            cursor += 16;
+        }
+        ASSERT_TRUE(fifo.empty());
+
+        auto buffer = fifo.reserve(large.size());
+        ASSERT_EQ(large.size(), buffer.size()) << "offset " << offset;
+        std::memcpy(buffer.data(), large.data(), large.size());
+        fifo.commit();
+        EXPECT_EQ(large, text(fifo.peek()));
+        fifo.release();
+        EXPECT_TRUE(fifo.empty());
+    }
+}
+
+TEST_F(ByteFifoTest, skipMarker) {
+    // 48 bytes used so only 16 remain before the end of the ring
+    EXPECT_TRUE(fifo.push(message("first")));
+    EXPECT_TRUE(fifo.push(message("second")));
+    EXPECT_TRUE(fifo.push(message("third")));
+    for (auto i = 0; i < 3; ++i) {
+        fifo.peek();
+        fifo.release();
+    }
+    EXPECT_TRUE(fifo.empty());
+
+    // 24 byte record doesn't fit at the end so it skips to the start
+    EXPECT_TRUE(fifo.push(message("wrapped!!")));
+    EXPECT_EQ(16u + 24u, fifo.size());
+    EXPECT_EQ("wrapped!!", text(fifo.peek()));
+    fifo.release();
+    EXPECT_TRUE(fifo.empty());
+
+    // 24 byte record fits exactly in the remaining 24 bytes before the end
+    EXPECT_TRUE(fifo.push(message("filler")));
+    fifo.peek();
+    fifo.release();
+    EXPECT_TRUE(fifo.push(message("1234567890123456")));
+    EXPECT_EQ(24u, fifo.size());
+    EXPECT_EQ("1234567890123456", text(fifo.peek()));
+    fifo.release();
+    EXPECT_TRUE(fifo.empty());
+    EXPECT_TRUE(fifo.push(message("start")));
+    EXPECT_EQ(16u, fifo.size());
+    EXPECT_EQ("start", text(fifo.peek()));
+}
+
+TEST_F(ByteFifoTest, skipNeedsRoom) {
+    EXPECT_TRUE(fifo.push(message("first")));
+    EXPECT_TRUE(fifo.push(message("second")));
+    EXPECT_TRUE(fifo.push(message("third")));
+    fifo.peek();
+    fifo.release();
+
+    // 16 free at the end and 16 free at the start; a 24 byte record
+    // needs 16 + 24 bytes
+    EXPECT_TRUE(fifo.reserve(9).empty());
+    EXPECT_TRUE(fifo.push(message("1234567")));
+}
+
+
+TEST(TopologyTest, parseList) {
+    using topology::detail::parseList;
+    EXPECT_EQ((std::vector<int>{0, 1, 2, 3, 8, 10, 11}), parseList("0-3,8,10-11"));
+    EXPECT_EQ((std::vector<int>{0, 1, 4, 5}), parseList("0-1,4-5\n"));
+    EXPECT_EQ((std::vector<int>{7}), parseList("7\n"));
+    EXPECT_EQ(std::vector<int>{}, parseList(""));
+    EXPECT_EQ(std::vector<int>{}, parseList("\n"));
+}
+
+namespace {
+
+// Two packages. Package 0: 0 and 1 are SMT siblings, 2 shares their L3.
+// Package 1: 4 and 5 share an L2, 3 and 4 an L3, 6 only the package.
+std::vector<topology::Cpu> const twoPackages = {
+    // id, core, package, l2, l3, node
+    {0, 0, 0, 0, 0, 0},
+    {1, 0, 0, 0, 0, 0},
+    {2, 1, 0, 2, 0, 0},
+    {3, 0, 1, 3, 3, 1},
+    {4, 1, 1, 4, 3, 1},
+    {5, 2, 1, 4, 3, 1},
+    {6, 3, 1, 6, 6, 1},
+};
+
+void expectPairs(std::vector<topology::CpuPair> const& expected, std::vector<topology::CpuPair> const& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (auto i = std::size_t{}; i < expected.size(); ++i) {
+        EXPECT_EQ(expected[i].sharing, actual[i].sharing) << i;
+        EXPECT_EQ(expected[i].cpu1, actual[i].cpu1) << i;
+        EXPECT_EQ(expected[i].cpu2, actual[i].cpu2) << i;
+    }
+}
+
+}  // namespace
+
+TEST(TopologyTest, sharing) {
+    using topology::Sharing;
+    auto const& cpus = twoPackages;
+    EXPECT_EQ(Sharing::smt, topology::sharing(cpus[0], cpus[1]));
+    EXPECT_EQ(Sharing::l2, topology::sharing(cpus[4], cpus[5]));
+    EXPECT_EQ(Sharing::l3, topology::sharing(cpus[0], cpus[2]));
+    EXPECT_EQ(Sharing::package, topology::sharing(cpus[3], cpus[6]));
+    EXPECT_EQ(Sharing::none, topology::sharing(cpus[0], cpus[3]));
+
+    // Nothing is known about a CPU without a package, even its caches
+    auto unknown = topology::Cpu{7, 0, -1, 0, 0, 0};
+    EXPECT_EQ(Sharing::unknown, topology::sharing(cpus[0], unknown));
+    EXPECT_EQ(Sharing::unknown, topology::sharing(unknown, cpus[3]));
+}
+
+TEST(TopologyTest, representativePairs) {
+    using topology::Sharing;
+    expectPairs({
+        {Sharing::smt, 0, 1},
+        {Sharing::l2, 4, 5},
+        {Sharing::l3, 0, 2},
+        {Sharing::package, 3, 6},
+        {Sharing::none, 0, 3}},
+        topology::representativePairs(twoPackages));
+
+    // Pairs with an unknown package are skipped, not reported cross-package
+    auto cpus = twoPackages;
+    cpus.push_back(topology::Cpu{7});
+    expectPairs(topology::representativePairs(twoPackages), topology::representativePairs(cpus));
+    expectPairs({}, topology::representativePairs({topology::Cpu{0}, topology::Cpu{1}}));
+    expectPairs({}, topology::representativePairs({}));
+}
+
+TEST(TopologyTest, nodePairs) {
+    using topology::Sharing;
+    // 0 and 1 are the first same-node pair, but SMT siblings
+    expectPairs({{Sharing::l3, 0, 2}, {Sharing::none, 0, 3}}, topology::nodePairs(twoPackages));
+
+    // Only SMT siblings on the same node
+    auto cpus = std::vector<topology::Cpu>(twoPackages.begin(), twoPackages.begin() + 2);
+    expectPairs({{Sharing::smt, 0, 1}}, topology::nodePairs(cpus));
+
+    // Unknown nodes are never paired
+    cpus = twoPackages;
+    for (auto& cpu : cpus) {
+        cpu.node = -1;
+    }
+    expectPairs({}, topology::nodePairs(cpus));
+}